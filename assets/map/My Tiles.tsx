@@ -1,4 +1,14 @@
 <?xml version="1.0" encoding="UTF-8"?>
 <tileset version="1.10" tiledversion="1.11.2" name="My Tiles" tilewidth="32" tileheight="32" tilecount="2" columns="2">
  <image source="myTiles/spikes.png" width="64" height="32"/>
+ <tile id="0" type="spike">
+  <properties>
+   <property name="damage" type="int" value="1"/>
+  </properties>
+ </tile>
+ <tile id="1" type="spike">
+  <properties>
+   <property name="damage" type="int" value="1"/>
+  </properties>
+ </tile>
 </tileset>
@@ -0,0 +1,228 @@
+#include "AabbBatch.hpp"
+#include <cmath>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define AABB_BATCH_AVX2
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define AABB_BATCH_SSE2
+#endif
+
+const char* aabbBatchPath(){
+#if defined(AABB_BATCH_AVX2)
+    return "avx2";
+#elif defined(AABB_BATCH_SSE2)
+    return "sse2";
+#else
+    return "scalar";
+#endif
+}
+
+// Scalar versions, also used for the tail the vector loops leave over
+
+static std::size_t overlapRange(const sf::FloatRect& box,
+                                const float* x, const float* y, const float* w, const float* h,
+                                std::size_t begin, std::size_t end, std::uint32_t* hits){
+    float left = box.position.x;
+    float top = box.position.y;
+    float right = left + box.size.x;
+    float bottom = top + box.size.y;
+
+    std::size_t hitCount = 0;
+    for (std::size_t i = begin; i < end; ++i){
+        if (left < x[i] + w[i] && right > x[i] && top < y[i] + h[i] && bottom > y[i]){
+            hits[hitCount++] = static_cast<std::uint32_t>(i);
+        }
+    }
+    return hitCount;
+}
+
+static void separateRange(const sf::FloatRect& box,
+                          const float* x, const float* y, const float* w, const float* h,
+                          std::size_t begin, std::size_t end, float* pushX, float* pushY){
+    float left = box.position.x;
+    float top = box.position.y;
+    float right = left + box.size.x;
+    float bottom = top + box.size.y;
+
+    for (std::size_t i = begin; i < end; ++i){
+        pushX[i] = 0.f;
+        pushY[i] = 0.f;
+        if (!(left < x[i] + w[i] && right > x[i] && top < y[i] + h[i] && bottom > y[i])) continue;
+
+        // out through the nearer side on each axis, then the shorter axis
+        float toLeft = left - (x[i] + w[i]);
+        float toRight = right - x[i];
+        float toTop = top - (y[i] + h[i]);
+        float toBottom = bottom - y[i];
+        float moveX = -toLeft < toRight ? toLeft : toRight;
+        float moveY = -toTop < toBottom ? toTop : toBottom;
+        if (std::abs(moveX) < std::abs(moveY)) pushX[i] = moveX;
+        else pushY[i] = moveY;
+    }
+}
+
+std::size_t overlapBatchScalar(const sf::FloatRect& box,
+                               const float* x, const float* y, const float* w, const float* h,
+                               std::size_t count, std::uint32_t* hits){
+    return overlapRange(box, x, y, w, h, 0, count, hits);
+}
+
+void separateBatchScalar(const sf::FloatRect& box,
+                         const float* x, const float* y, const float* w, const float* h,
+                         std::size_t count, float* pushX, float* pushY){
+    separateRange(box, x, y, w, h, 0, count, pushX, pushY);
+}
+
+#if defined(AABB_BATCH_AVX2)
+
+std::size_t overlapBatch(const sf::FloatRect& box,
+                         const float* x, const float* y, const float* w, const float* h,
+                         std::size_t count, std::uint32_t* hits){
+    const __m256 left = _mm256_set1_ps(box.position.x);
+    const __m256 top = _mm256_set1_ps(box.position.y);
+    const __m256 right = _mm256_set1_ps(box.position.x + box.size.x);
+    const __m256 bottom = _mm256_set1_ps(box.position.y + box.size.y);
+
+    std::size_t hitCount = 0;
+    std::size_t i = 0;
+    for (; i + 8 <= count; i += 8){
+        __m256 bx = _mm256_loadu_ps(x + i);
+        __m256 by = _mm256_loadu_ps(y + i);
+        __m256 bw = _mm256_loadu_ps(w + i);
+        __m256 bh = _mm256_loadu_ps(h + i);
+
+        __m256 hit = _mm256_and_ps(_mm256_cmp_ps(left, _mm256_add_ps(bx, bw), _CMP_LT_OQ),
+                                   _mm256_cmp_ps(right, bx, _CMP_GT_OQ));
+        hit = _mm256_and_ps(hit, _mm256_cmp_ps(top, _mm256_add_ps(by, bh), _CMP_LT_OQ));
+        hit = _mm256_and_ps(hit, _mm256_cmp_ps(bottom, by, _CMP_GT_OQ));
+
+        // one bit per lane, most groups of 8 have no hit at all
+        int mask = _mm256_movemask_ps(hit);
+        for (int lane = 0; mask != 0; ++lane, mask >>= 1){
+            if (mask & 1) hits[hitCount++] = static_cast<std::uint32_t>(i + lane);
+        }
+    }
+    return hitCount + overlapRange(box, x, y, w, h, i, count, hits + hitCount);
+}
+
+void separateBatch(const sf::FloatRect& box,
+                   const float* x, const float* y, const float* w, const float* h,
+                   std::size_t count, float* pushX, float* pushY){
+    const __m256 left = _mm256_set1_ps(box.position.x);
+    const __m256 top = _mm256_set1_ps(box.position.y);
+    const __m256 right = _mm256_set1_ps(box.position.x + box.size.x);
+    const __m256 bottom = _mm256_set1_ps(box.position.y + box.size.y);
+    const __m256 signBit = _mm256_set1_ps(-0.f);
+
+    std::size_t i = 0;
+    for (; i + 8 <= count; i += 8){
+        __m256 bx = _mm256_loadu_ps(x + i);
+        __m256 by = _mm256_loadu_ps(y + i);
+        __m256 bx1 = _mm256_add_ps(bx, _mm256_loadu_ps(w + i));
+        __m256 by1 = _mm256_add_ps(by, _mm256_loadu_ps(h + i));
+
+        __m256 hit = _mm256_and_ps(_mm256_cmp_ps(left, bx1, _CMP_LT_OQ), _mm256_cmp_ps(right, bx, _CMP_GT_OQ));
+        hit = _mm256_and_ps(hit, _mm256_cmp_ps(top, by1, _CMP_LT_OQ));
+        hit = _mm256_and_ps(hit, _mm256_cmp_ps(bottom, by, _CMP_GT_OQ));
+
+        __m256 toLeft = _mm256_sub_ps(left, bx1);
+        __m256 toRight = _mm256_sub_ps(right, bx);
+        __m256 toTop = _mm256_sub_ps(top, by1);
+        __m256 toBottom = _mm256_sub_ps(bottom, by);
+        __m256 moveX = _mm256_blendv_ps(toRight, toLeft, _mm256_cmp_ps(_mm256_xor_ps(toLeft, signBit), toRight, _CMP_LT_OQ));
+        __m256 moveY = _mm256_blendv_ps(toBottom, toTop, _mm256_cmp_ps(_mm256_xor_ps(toTop, signBit), toBottom, _CMP_LT_OQ));
+
+        __m256 useX = _mm256_cmp_ps(_mm256_andnot_ps(signBit, moveX), _mm256_andnot_ps(signBit, moveY), _CMP_LT_OQ);
+        _mm256_storeu_ps(pushX + i, _mm256_and_ps(hit, _mm256_and_ps(useX, moveX)));
+        _mm256_storeu_ps(pushY + i, _mm256_and_ps(hit, _mm256_andnot_ps(useX, moveY)));
+    }
+    separateRange(box, x, y, w, h, i, count, pushX, pushY);
+}
+
+#elif defined(AABB_BATCH_SSE2)
+
+// SSE2 has no blend, pick between a and b with and/andnot/or
+static inline __m128 blendMask(__m128 mask, __m128 a, __m128 b){
+    return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+
+std::size_t overlapBatch(const sf::FloatRect& box,
+                         const float* x, const float* y, const float* w, const float* h,
+                         std::size_t count, std::uint32_t* hits){
+    const __m128 left = _mm_set1_ps(box.position.x);
+    const __m128 top = _mm_set1_ps(box.position.y);
+    const __m128 right = _mm_set1_ps(box.position.x + box.size.x);
+    const __m128 bottom = _mm_set1_ps(box.position.y + box.size.y);
+
+    std::size_t hitCount = 0;
+    std::size_t i = 0;
+    for (; i + 4 <= count; i += 4){
+        __m128 bx = _mm_loadu_ps(x + i);
+        __m128 by = _mm_loadu_ps(y + i);
+        __m128 bw = _mm_loadu_ps(w + i);
+        __m128 bh = _mm_loadu_ps(h + i);
+
+        __m128 hit = _mm_and_ps(_mm_cmplt_ps(left, _mm_add_ps(bx, bw)), _mm_cmpgt_ps(right, bx));
+        hit = _mm_and_ps(hit, _mm_cmplt_ps(top, _mm_add_ps(by, bh)));
+        hit = _mm_and_ps(hit, _mm_cmpgt_ps(bottom, by));
+
+        // one bit per lane, most groups of 4 have no hit at all
+        int mask = _mm_movemask_ps(hit);
+        for (int lane = 0; mask != 0; ++lane, mask >>= 1){
+            if (mask & 1) hits[hitCount++] = static_cast<std::uint32_t>(i + lane);
+        }
+    }
+    return hitCount + overlapRange(box, x, y, w, h, i, count, hits + hitCount);
+}
+
+void separateBatch(const sf::FloatRect& box,
+                   const float* x, const float* y, const float* w, const float* h,
+                   std::size_t count, float* pushX, float* pushY){
+    const __m128 left = _mm_set1_ps(box.position.x);
+    const __m128 top = _mm_set1_ps(box.position.y);
+    const __m128 right = _mm_set1_ps(box.position.x + box.size.x);
+    const __m128 bottom = _mm_set1_ps(box.position.y + box.size.y);
+    const __m128 signBit = _mm_set1_ps(-0.f);
+
+    std::size_t i = 0;
+    for (; i + 4 <= count; i += 4){
+        __m128 bx = _mm_loadu_ps(x + i);
+        __m128 by = _mm_loadu_ps(y + i);
+        __m128 bx1 = _mm_add_ps(bx, _mm_loadu_ps(w + i));
+        __m128 by1 = _mm_add_ps(by, _mm_loadu_ps(h + i));
+
+        __m128 hit = _mm_and_ps(_mm_cmplt_ps(left, bx1), _mm_cmpgt_ps(right, bx));
+        hit = _mm_and_ps(hit, _mm_cmplt_ps(top, by1));
+        hit = _mm_and_ps(hit, _mm_cmpgt_ps(bottom, by));
+
+        __m128 toLeft = _mm_sub_ps(left, bx1);
+        __m128 toRight = _mm_sub_ps(right, bx);
+        __m128 toTop = _mm_sub_ps(top, by1);
+        __m128 toBottom = _mm_sub_ps(bottom, by);
+        __m128 moveX = blendMask(_mm_cmplt_ps(_mm_xor_ps(toLeft, signBit), toRight), toLeft, toRight);
+        __m128 moveY = blendMask(_mm_cmplt_ps(_mm_xor_ps(toTop, signBit), toBottom), toTop, toBottom);
+
+        __m128 useX = _mm_cmplt_ps(_mm_andnot_ps(signBit, moveX), _mm_andnot_ps(signBit, moveY));
+        _mm_storeu_ps(pushX + i, _mm_and_ps(hit, _mm_and_ps(useX, moveX)));
+        _mm_storeu_ps(pushY + i, _mm_and_ps(hit, _mm_andnot_ps(useX, moveY)));
+    }
+    separateRange(box, x, y, w, h, i, count, pushX, pushY);
+}
+
+#else
+
+std::size_t overlapBatch(const sf::FloatRect& box,
+                         const float* x, const float* y, const float* w, const float* h,
+                         std::size_t count, std::uint32_t* hits){
+    return overlapRange(box, x, y, w, h, 0, count, hits);
+}
+
+void separateBatch(const sf::FloatRect& box,
+                   const float* x, const float* y, const float* w, const float* h,
+                   std::size_t count, float* pushX, float* pushY){
+    separateRange(box, x, y, w, h, 0, count, pushX, pushY);
+}
+
+#endif
@@ -0,0 +1,44 @@
+#pragma once
+#include <SFML/Graphics.hpp>
+#include <cstddef>
+#include <cstdint>
+
+// Box tests of one box against many, with the many stored as separate x, y,
+// width and height arrays (the layout EntityWorld keeps its components in).
+// Built with AVX2 when the compiler targets it (make USE_AVX2=1), SSE2 on
+// any other x86-64 build, and plain loops everywhere else. The results are
+// the same on every path
+
+// Which path this build uses, "avx2", "sse2" or "scalar"
+const char* aabbBatchPath();
+
+// One box against one, the same test the batch versions make per box
+inline bool boxesOverlap(const sf::FloatRect& a, const sf::FloatRect& b){
+    return a.position.x < b.position.x + b.size.x &&
+           a.position.x + a.size.x > b.position.x &&
+           a.position.y < b.position.y + b.size.y &&
+           a.position.y + a.size.y > b.position.y;
+}
+
+// Writes the index of every box overlapping box into hits (room for count
+// entries), in increasing order. Touching edges do not count, same as
+// sf::FloatRect::findIntersection. Returns how many were written
+std::size_t overlapBatch(const sf::FloatRect& box,
+                         const float* x, const float* y, const float* w, const float* h,
+                         std::size_t count, std::uint32_t* hits);
+
+// For every box, the smallest move along one axis that takes it out of box,
+// or (0, 0) where they do not overlap. Ties go to the vertical axis
+void separateBatch(const sf::FloatRect& box,
+                   const float* x, const float* y, const float* w, const float* h,
+                   std::size_t count, float* pushX, float* pushY);
+
+// The plain loop versions, always available so the SIMD paths can be
+// checked and timed against them
+std::size_t overlapBatchScalar(const sf::FloatRect& box,
+                               const float* x, const float* y, const float* w, const float* h,
+                               std::size_t count, std::uint32_t* hits);
+
+void separateBatchScalar(const sf::FloatRect& box,
+                         const float* x, const float* y, const float* w, const float* h,
+                         std::size_t count, float* pushX, float* pushY);
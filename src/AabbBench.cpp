@@ -0,0 +1,131 @@
+#include "AabbBench.hpp"
+#include "AabbBatch.hpp"
+#include "Log.hpp"
+#include <chrono>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+namespace {
+
+// Boxes as component arrays, the layout the batch tests take
+struct Boxes {
+    std::vector<float> x;
+    std::vector<float> y;
+    std::vector<float> w;
+    std::vector<float> h;
+};
+
+// Spread over a 4000x1000 world, 0 to 64 wide. Whole pixels, so edges line
+// up and the touching-but-not-overlapping case comes up often
+Boxes randomBoxes(std::size_t count, std::mt19937& rng){
+    std::uniform_int_distribution<int> posX(0, 4000);
+    std::uniform_int_distribution<int> posY(0, 1000);
+    std::uniform_int_distribution<int> size(0, 64);
+    Boxes boxes;
+    for (std::size_t i = 0; i < count; ++i){
+        boxes.x.push_back((float)posX(rng));
+        boxes.y.push_back((float)posY(rng));
+        boxes.w.push_back((float)size(rng));
+        boxes.h.push_back((float)size(rng));
+    }
+    return boxes;
+}
+
+// Microseconds per call of run, averaged over rounds
+template <typename Run>
+double timeCalls(int rounds, Run run){
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < rounds; ++i) run();
+    std::chrono::duration<double, std::micro> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count() / rounds;
+}
+
+} // namespace
+
+bool checkAabbBatch(unsigned seed){
+    std::mt19937 rng(seed);
+    std::uniform_int_distribution<int> queryX(-100, 4000);
+    std::uniform_int_distribution<int> queryY(-100, 1000);
+    std::uniform_int_distribution<int> querySize(0, 400);
+
+    const std::size_t counts[] = {0, 1, 3, 4, 5, 7, 8, 9, 15, 16, 17, 63, 64, 1000, 4099};
+    for (std::size_t count : counts){
+        Boxes boxes = randomBoxes(count, rng);
+        std::vector<std::uint32_t> hits(count), expectedHits(count);
+        std::vector<float> pushX(count), pushY(count), expectedX(count), expectedY(count);
+
+        for (int query = 0; query < 200; ++query){
+            // every tenth query is one of the boxes itself
+            sf::FloatRect box({(float)queryX(rng), (float)queryY(rng)}, {(float)querySize(rng), (float)querySize(rng)});
+            if (count > 0 && query % 10 == 0){
+                std::size_t i = rng() % count;
+                box = sf::FloatRect({boxes.x[i], boxes.y[i]}, {boxes.w[i], boxes.h[i]});
+            }
+            const float* x = boxes.x.data();
+            const float* y = boxes.y.data();
+            const float* w = boxes.w.data();
+            const float* h = boxes.h.data();
+
+            std::size_t hitCount = overlapBatch(box, x, y, w, h, count, hits.data());
+            std::size_t expectedCount = overlapBatchScalar(box, x, y, w, h, count, expectedHits.data());
+            if (hitCount != expectedCount){
+                LOG_ERROR("overlapBatch (" << aabbBatchPath() << ") found " << hitCount << " hits over "
+                          << count << " boxes, the scalar loop " << expectedCount);
+                return false;
+            }
+            for (std::size_t i = 0; i < hitCount; ++i){
+                if (hits[i] != expectedHits[i]){
+                    LOG_ERROR("overlapBatch (" << aabbBatchPath() << ") hit " << i << " is box " << hits[i]
+                              << ", the scalar loop's is box " << expectedHits[i]);
+                    return false;
+                }
+            }
+
+            separateBatch(box, x, y, w, h, count, pushX.data(), pushY.data());
+            separateBatchScalar(box, x, y, w, h, count, expectedX.data(), expectedY.data());
+            for (std::size_t i = 0; i < count; ++i){
+                if (pushX[i] != expectedX[i] || pushY[i] != expectedY[i]){
+                    LOG_ERROR("separateBatch (" << aabbBatchPath() << ") pushes box " << i << " of " << count
+                              << " by (" << pushX[i] << ", " << pushY[i] << "), the scalar loop by ("
+                              << expectedX[i] << ", " << expectedY[i] << ")");
+                    return false;
+                }
+            }
+        }
+    }
+    LOG_INFO("Batch box tests (" << aabbBatchPath() << ") match the scalar loops");
+    return true;
+}
+
+void benchmarkAabbBatch(std::size_t count, int rounds){
+    if (count == 0 || rounds <= 0) return;
+    std::mt19937 rng(7);
+    Boxes boxes = randomBoxes(count, rng);
+    const float* x = boxes.x.data();
+    const float* y = boxes.y.data();
+    const float* w = boxes.w.data();
+    const float* h = boxes.h.data();
+    std::vector<std::uint32_t> hits(count);
+    std::vector<float> pushX(count), pushY(count);
+
+    // about what a 960x540 view over the world catches
+    const sf::FloatRect view({1500.f, 200.f}, {960.f, 540.f});
+    // so the calls can't be optimised away
+    volatile std::size_t sink = 0;
+
+    double overlapScalar = timeCalls(rounds, [&]{ sink = sink + overlapBatchScalar(view, x, y, w, h, count, hits.data()); });
+    double overlapSimd = timeCalls(rounds, [&]{ sink = sink + overlapBatch(view, x, y, w, h, count, hits.data()); });
+    double separateScalar = timeCalls(rounds, [&]{
+        separateBatchScalar(view, x, y, w, h, count, pushX.data(), pushY.data());
+        sink = sink + (pushX[count / 2] != 0.f);
+    });
+    double separateSimd = timeCalls(rounds, [&]{
+        separateBatch(view, x, y, w, h, count, pushX.data(), pushY.data());
+        sink = sink + (pushX[count / 2] != 0.f);
+    });
+
+    LOG_INFO("Batch box tests over " << count << " boxes, " << aabbBatchPath() << " against scalar:");
+    LOG_INFO("  overlap:  " << overlapScalar << " us -> " << overlapSimd << " us, x" << overlapScalar / overlapSimd);
+    LOG_INFO("  separate: " << separateScalar << " us -> " << separateSimd << " us, x" << separateScalar / separateSimd);
+}
@@ -0,0 +1,16 @@
+#pragma once
+#include <cstddef>
+
+// Checks and times the batch box tests (AabbBatch) of this build against
+// their scalar loops, run with --aabb-bench. Build once with make USE_AVX2=1
+// and once without to cover both SIMD paths. The timings only mean something
+// from an optimised build
+
+// Runs both paths on the same random boxes, batch sizes 0 to 4099 so every
+// vector tail is hit, with whole-pixel coordinates so boxes often share
+// edges. False, with the first difference logged, unless every hit list and
+// push is identical
+bool checkAabbBatch(unsigned seed = 1);
+
+// Times both paths over count boxes and logs the time per call and the speedup
+void benchmarkAabbBatch(std::size_t count = 4096, int rounds = 20000);
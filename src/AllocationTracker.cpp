@@ -0,0 +1,265 @@
+#include "AllocationTracker.hpp"
+#include "Log.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <vector>
+
+#if defined(TRACK_ALLOCATIONS) && defined(__linux__)
+#include <cxxabi.h>
+#include <dlfcn.h>
+#include <execinfo.h>
+#define TRACK_CALL_SITES
+#endif
+
+namespace {
+
+// Plain data only, so touching them from operator new never allocates
+thread_local AllocationCounts threadCounters;
+thread_local int expectedDepth = 0;
+
+std::atomic<std::uint64_t> totalAllocations{0};
+std::atomic<std::uint64_t> totalFrees{0};
+std::atomic<std::uint64_t> totalBytes{0};
+std::atomic<std::uint64_t> totalExpected{0};
+std::atomic<std::uint64_t> sampleRate{AllocationTracker::DEFAULT_SAMPLE_RATE};
+
+#if defined(TRACK_CALL_SITES)
+thread_local bool sampling = false;
+
+// Frames kept per sample, the first two are record() and operator new
+const int SKIPPED_FRAMES = 2;
+const int SITE_FRAMES = 5;
+
+// Open addressing table of sampled call sites, slots are claimed by
+// swapping their hash in and never given back until clearCallSites
+const std::size_t SITE_SLOTS = 512;
+struct CallSite {
+    std::atomic<std::uint64_t> hash{0};
+    std::atomic<bool> ready{false};
+    void* frames[SITE_FRAMES] = {};
+    int depth = 0;
+    std::atomic<std::uint64_t> samples{0};
+};
+CallSite callSites[SITE_SLOTS];
+
+void sampleCallSite(){
+    void* frames[SKIPPED_FRAMES + SITE_FRAMES];
+    int depth = backtrace(frames, SKIPPED_FRAMES + SITE_FRAMES) - SKIPPED_FRAMES;
+    if (depth <= 0) return;
+
+    std::uint64_t hash = 1469598103934665603ull;
+    for (int i = 0; i < depth; ++i){
+        hash = (hash ^ (std::uint64_t)(std::uintptr_t)frames[SKIPPED_FRAMES + i]) * 1099511628211ull;
+    }
+    hash |= 1; // 0 marks a free slot
+
+    for (std::size_t probe = 0; probe < SITE_SLOTS; ++probe){
+        CallSite& site = callSites[(hash + probe) % SITE_SLOTS];
+        std::uint64_t current = site.hash.load(std::memory_order_acquire);
+        if (current == 0 && site.hash.compare_exchange_strong(current, hash)){
+            std::copy(frames + SKIPPED_FRAMES, frames + SKIPPED_FRAMES + depth, site.frames);
+            site.depth = depth;
+            site.ready.store(true, std::memory_order_release);
+            current = hash;
+        }
+        if (current == hash){
+            site.samples.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+    }
+    // table full, the sample is dropped
+}
+
+// "function+0x1f" if the symbol is exported (link with -rdynamic),
+// otherwise "binary(+0x1234)" for addr2line
+std::string describeFrame(void* address){
+    Dl_info info;
+    if (!dladdr(address, &info)) return "??";
+    if (info.dli_sname){
+        int status = 0;
+        char* demangled = abi::__cxa_demangle(info.dli_sname, nullptr, nullptr, &status);
+        std::string name = status == 0 ? demangled : info.dli_sname;
+        std::free(demangled);
+        return name;
+    }
+    char offset[32];
+    std::snprintf(offset, sizeof(offset), "(+0x%zx)", (std::size_t)((char*)address - (char*)info.dli_fbase));
+    return std::string(info.dli_fname ? info.dli_fname : "??") + offset;
+}
+#endif
+
+#if defined(TRACK_ALLOCATIONS)
+void record(std::size_t size){
+    AllocationCounts& counts = threadCounters;
+    ++counts.allocations;
+    counts.bytes += size;
+    totalAllocations.fetch_add(1, std::memory_order_relaxed);
+    totalBytes.fetch_add(size, std::memory_order_relaxed);
+    if (expectedDepth > 0){
+        ++counts.expected;
+        totalExpected.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+#if defined(TRACK_CALL_SITES)
+    // backtrace can allocate the first time it runs, that one isn't sampled
+    if (counts.allocations % sampleRate.load(std::memory_order_relaxed) != 0 || sampling) return;
+    sampling = true;
+    sampleCallSite();
+    sampling = false;
+#endif
+}
+#endif
+
+} // namespace
+
+#if defined(TRACK_ALLOCATIONS)
+
+// The other forms (arrays, nothrow) go through these in libstdc++ and
+// libc++. Over-aligned new doesn't and isn't counted
+void* operator new(std::size_t size){
+    void* memory = std::malloc(size ? size : 1);
+    if (!memory) throw std::bad_alloc();
+    record(size);
+    return memory;
+}
+
+void operator delete(void* memory) noexcept{
+    if (!memory) return;
+    ++threadCounters.frees;
+    totalFrees.fetch_add(1, std::memory_order_relaxed);
+    std::free(memory);
+}
+
+void operator delete(void* memory, std::size_t) noexcept{
+    operator delete(memory);
+}
+
+bool AllocationTracker::isEnabled(){
+    return true;
+}
+
+#else
+
+bool AllocationTracker::isEnabled(){
+    return false;
+}
+
+#endif
+
+void AllocationTracker::setSampleRate(std::uint64_t rate){
+    sampleRate.store(std::max<std::uint64_t>(rate, 1), std::memory_order_relaxed);
+}
+
+AllocationCounts AllocationTracker::threadCounts(){
+    return threadCounters;
+}
+
+AllocationCounts AllocationTracker::totalCounts(){
+    AllocationCounts counts;
+    counts.allocations = totalAllocations.load(std::memory_order_relaxed);
+    counts.frees = totalFrees.load(std::memory_order_relaxed);
+    counts.bytes = totalBytes.load(std::memory_order_relaxed);
+    counts.expected = totalExpected.load(std::memory_order_relaxed);
+    return counts;
+}
+
+void AllocationTracker::logCallSites(std::size_t count){
+#if defined(TRACK_CALL_SITES)
+    std::vector<const CallSite*> sites;
+    for (const auto& site : callSites){
+        if (site.ready.load(std::memory_order_acquire) && site.samples.load(std::memory_order_relaxed) > 0) sites.push_back(&site);
+    }
+    std::sort(sites.begin(), sites.end(), [](const CallSite* a, const CallSite* b){
+        return a->samples.load(std::memory_order_relaxed) > b->samples.load(std::memory_order_relaxed);
+    });
+    if (sites.size() > count) sites.resize(count);
+
+    std::uint64_t rate = sampleRate.load(std::memory_order_relaxed);
+    LOG_INFO("Busiest allocation call sites (1 in " << rate << " allocations sampled):");
+    for (const CallSite* site : sites){
+        LOG_INFO("  ~" << site->samples.load(std::memory_order_relaxed) * rate << " allocations");
+        for (int i = 0; i < site->depth; ++i){
+            LOG_INFO("      " << describeFrame(site->frames[i]));
+        }
+    }
+#else
+    (void)count;
+    LOG_INFO("Allocation call sites aren't sampled in this build");
+#endif
+}
+
+void AllocationTracker::clearCallSites(){
+#if defined(TRACK_CALL_SITES)
+    for (auto& site : callSites){
+        site.samples.store(0, std::memory_order_relaxed);
+    }
+#endif
+}
+
+ExpectedAllocations::ExpectedAllocations(){
+    ++expectedDepth;
+}
+
+ExpectedAllocations::~ExpectedAllocations(){
+    --expectedDepth;
+}
+
+bool FrameAllocations::beginFrame(const std::string& state){
+    AllocationCounts now = AllocationTracker::threadCounts();
+    std::uint64_t allocations = now.allocations - _last.allocations;
+    std::uint64_t expected = now.expected - _last.expected;
+    std::uint64_t unexpected = allocations - expected;
+
+    {
+        // the first frame of a state adds it to the map
+        ExpectedAllocations bookkeeping;
+        if (!_state.empty()){
+            StateStats& stats = _states[_state];
+            ++stats.frames;
+            stats.allocations += allocations;
+            stats.bytes += now.bytes - _last.bytes;
+            stats.expected += expected;
+            stats.maxPerFrame = std::max(stats.maxPerFrame, unexpected);
+            if (unexpected > 0) ++stats.allocatingFrames;
+
+            if (_state == _testState && _framesInState > WARMUP_FRAMES && unexpected > 0 && !_failed){
+                fail("frame " + std::to_string(_framesInState) + " of " + _state + " made " +
+                     std::to_string(unexpected) + " allocations after warm-up");
+            }
+        }
+
+        if (state != _state){
+            _state = state;
+            _framesInState = 0;
+        }
+        ++_framesInState;
+        // from here on every allocation is a failure, keep all of them
+        if (_state == _testState && _framesInState == WARMUP_FRAMES){
+            AllocationTracker::clearCallSites();
+            AllocationTracker::setSampleRate(1);
+        }
+    }
+    _last = AllocationTracker::threadCounts();
+    return !_failed;
+}
+
+void FrameAllocations::fail(const std::string& reason){
+    _failed = true;
+    LOG_ERROR("Allocation test failed: " << reason);
+    AllocationTracker::logCallSites();
+}
+
+void FrameAllocations::logStats() const{
+    for (const auto& [state, stats] : _states){
+        if (stats.frames == 0) continue;
+        LOG_INFO("Allocations in " << state << ": " << stats.frames << " frames, "
+                 << stats.allocatingFrames << " allocating, "
+                 << (double)(stats.allocations - stats.expected) / stats.frames << " per frame, max "
+                 << stats.maxPerFrame << ", " << stats.bytes / 1024 << " KB, "
+                 << stats.expected << " expected (streaming, loading)");
+    }
+}
@@ -0,0 +1,93 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <string>
+
+// Heap allocations made so far, by one thread or by all of them
+struct AllocationCounts {
+    std::uint64_t allocations = 0;
+    std::uint64_t frees = 0;
+    std::uint64_t bytes = 0;      // requested, not what malloc rounded up to
+    std::uint64_t expected = 0;   // of allocations, made under ExpectedAllocations
+};
+
+// Counts every operator new and delete when the game is built with
+// TRACK_ALLOCATIONS (make TRACK_ALLOCS=1). Counters are kept per thread and
+// in total, and every n-th allocation of a thread records a short backtrace
+// so the busiest call sites can be listed. Without the flag the global
+// operators are left alone and everything here reads zero
+class AllocationTracker {
+public:
+    static const std::uint64_t DEFAULT_SAMPLE_RATE = 16;
+
+    static bool isEnabled();
+
+    // Sample one in rate allocations, 1 for every one
+    static void setSampleRate(std::uint64_t rate);
+
+    // Counts of the calling thread
+    static AllocationCounts threadCounts();
+    // Counts of every thread
+    static AllocationCounts totalCounts();
+
+    // Most sampled call sites, busiest first
+    static void logCallSites(std::size_t count = 10);
+
+    // Forget the sampled call sites, e.g. once warm-up is over
+    static void clearCallSites();
+};
+
+// Allocations the calling thread makes while one of these is alive are
+// expected ones (streaming chunks in, loading a level, reloading assets)
+// and don't count against allocation free frames
+class ExpectedAllocations {
+public:
+    ExpectedAllocations();
+    ~ExpectedAllocations();
+
+    ExpectedAllocations(const ExpectedAllocations&) = delete;
+    ExpectedAllocations& operator=(const ExpectedAllocations&) = delete;
+};
+
+// Allocations per frame of the calling thread, grouped by game state.
+// In test mode a frame of the checked state that allocates once its
+// warm-up is over fails the test
+class FrameAllocations {
+public:
+    // Frames of a state that may allocate before it is checked, counted
+    // again each time the state is entered
+    static const int WARMUP_FRAMES = 120;
+
+    // Fail on allocations in frames of state after warm-up
+    void setTestMode(const std::string& state) { _testState = state; }
+
+    // Call at the start of every frame with the state it runs in, what was
+    // allocated since the last call goes to the frame before. Returns
+    // false once the test has failed
+    bool beginFrame(const std::string& state);
+
+    // Fail the test for some other reason, e.g. another thread allocating
+    void fail(const std::string& reason);
+    bool hasFailed() const { return _failed; }
+
+    // Per state totals since the start
+    void logStats() const;
+
+private:
+    struct StateStats {
+        std::uint64_t frames = 0;
+        std::uint64_t allocatingFrames = 0;
+        std::uint64_t allocations = 0;
+        std::uint64_t bytes = 0;
+        std::uint64_t expected = 0;
+        std::uint64_t maxPerFrame = 0;
+    };
+
+    std::map<std::string, StateStats> _states;
+    std::string _state;
+    int _framesInState = 0;
+    AllocationCounts _last;
+    std::string _testState;
+    bool _failed = false;
+};
@@ -1,29 +1,70 @@
 #include "Animation.hpp"
+#include "Log.hpp"
 #include <filesystem>
-#include <iostream>
 #include <algorithm>
 
 namespace fs = std::filesystem;
 
+// Counts a frame as a shared resource, animations outlive levels
+static MemoryRecord frameMemory(const std::string& path, const sf::Texture& texture){
+    return MemoryRecord({ResourceKind::TEXTURE, "", "Animations", path, texture.getSize(),
+                         ResourceMemory::textureBytes(texture.getSize())});
+}
+
 // Constructor: loads animation frames from folder and sets playback speed
 Animation::Animation(const std::string& baseFolderPath, float speed){
     loadFromFolder(baseFolderPath);
     setSpeed(speed);
 }
 
-// Constructor: loads directional animation from subfolder
+// Constructor: loads every direction from the subfolders, so turning around
+// only switches between frames already on the GPU
 Animation::Animation(const std::string& baseFolderPath, float speed, bool moves){
     setSpeed(speed);
-    loadFromFolder(baseFolderPath + "/" + _currentDirection);
+
+    std::vector<fs::path> folders;
+    for (const auto& entry : fs::directory_iterator(baseFolderPath)){
+        if (entry.is_directory()) folders.push_back(entry.path());
+    }
+    std::sort(folders.begin(), folders.end());
+    for (const auto& folder : folders){
+        Clip clip;
+        clip.direction = folder.filename().string();
+        clip.folder = folder.string();
+        if (loadClip(clip)) _clips.push_back(std::move(clip));
+    }
+
+    if (_clips.empty()){
+        LOG_WARNING("No animation folders found in: " << baseFolderPath);
+        return;
+    }
+    std::size_t start = 0;
+    for (std::size_t i = 0; i < _clips.size(); ++i){
+        if (_clips[i].direction == _currentDirection) start = i;
+    }
+    _currentDirection = _clips[start].direction;
+    showClip(start, 0);
 }
 
 // Loads all image files from folder into frame array
 void Animation::loadFromFolder(const std::string& folderPath){
-    _frames.clear();
     _sprite.reset(); // remove any previous sprite
-    
+    _clips.clear();
+
+    Clip clip;
+    clip.folder = folderPath;
+    if (!loadClip(clip)) return;
+    _clips.push_back(std::move(clip));
+    showClip(0, 0);
+}
+
+bool Animation::loadClip(Clip& clip){
+    clip.frames.clear();
+    clip.framePaths.clear();
+    clip.frameMemory.clear();
+
     std::vector<fs::path> imageFiles;
-    for (const auto& entry : fs::directory_iterator(folderPath)){
+    for (const auto& entry : fs::directory_iterator(clip.folder)){
         if (entry.is_regular_file()){
             auto ext = entry.path().extension().string();
             std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
@@ -34,29 +75,85 @@ void Animation::loadFromFolder(const std::string& folderPath){
     }
     
     if (imageFiles.empty()){
-        std::cerr << "No image files found in folder: " << folderPath << "\n";
-        return;
+        LOG_WARNING("No image files found in folder: " << clip.folder);
+        return false;
     }
     
     for (const auto& path : imageFiles){
         sf::Texture texture;
         if (!texture.loadFromFile(path.string())){
-            std::cerr << "Failed to load texture: " << path << "\n";
+            LOG_ERROR("Failed to load texture: " << path);
             continue;
         }
-        _frames.push_back(std::move(texture));
+        clip.frameMemory.push_back(frameMemory(path.string(), texture));
+        clip.frames.push_back(std::move(texture));
+        clip.framePaths.push_back(path.string());
     }
-    
-    if (!_frames.empty()){
-        _sprite = std::make_unique<sf::Sprite>(_frames[0]);
+    return !clip.frames.empty();
+}
+
+void Animation::showClip(std::size_t clip, std::size_t frame){
+    _clip = clip;
+    const std::vector<sf::Texture>& frames = _clips[clip].frames;
+    if (frames.empty()){
+        _sprite.reset();
+        _currentFrame = 0;
+        return;
     }
+    _currentFrame = frame % frames.size();
+    if (_sprite) _sprite->setTexture(frames[_currentFrame], true);
+    else _sprite = std::make_unique<sf::Sprite>(frames[_currentFrame]);
 }
 
-// Changes animation direction and reloads frames from corresponding subfolder
-void Animation::setDirection(const std::string& newDirection, const std::string& baseFolderPath){
+// Changes animation direction to frames loaded by the constructor
+void Animation::setDirection(const std::string& newDirection){
     if (newDirection == _currentDirection) return; // no change
     _currentDirection = newDirection;
-    loadFromFolder(baseFolderPath + "/" + _currentDirection);
+    for (std::size_t i = 0; i < _clips.size(); ++i){
+        if (_clips[i].direction == newDirection){
+            showClip(i, 0);
+            return;
+        }
+    }
+    LOG_WARNING("No animation frames for direction: " << newDirection);
+}
+
+// Swaps a changed frame in place or reloads the folder it was added to or removed from
+bool Animation::reloadFile(const std::string& path){
+    std::error_code error;
+    fs::path changed = fs::weakly_canonical(path, error);
+
+    for (std::size_t c = 0; c < _clips.size(); ++c){
+        Clip& clip = _clips[c];
+        for (std::size_t i = 0; i < clip.framePaths.size(); ++i){
+            if (fs::weakly_canonical(clip.framePaths[i], error) != changed || !fs::exists(path, error)) continue;
+            sf::Texture texture;
+            if (!texture.loadFromFile(path)){
+                LOG_ERROR("Failed to reload texture: " << path);
+                return false;
+            }
+            clip.frameMemory[i] = frameMemory(path, texture);
+            clip.frames[i] = std::move(texture);
+            if (c == _clip && _sprite) _sprite->setTexture(clip.frames[_currentFrame], true); // the size may have changed
+            LOG_INFO("Reloaded frame " << path);
+            return true;
+        }
+    }
+
+    auto ext = changed.extension().string();
+    std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+    if (ext != ".png" && ext != ".jpg" && ext != ".jpeg") return false;
+
+    for (std::size_t c = 0; c < _clips.size(); ++c){
+        Clip& clip = _clips[c];
+        if (fs::weakly_canonical(clip.folder, error) != changed.parent_path()) continue;
+        // frames were added or removed, the sprite stays where it was
+        loadClip(clip);
+        if (c == _clip) showClip(c, _currentFrame);
+        LOG_INFO("Reloaded " << clip.frames.size() << " frames from " << clip.folder);
+        return true;
+    }
+    return false;
 }
 
 // Sets frames per second, clamps to minimum 1.0 fps
@@ -67,15 +164,26 @@ void Animation::setSpeed(float speed){
 
 // Advances animation based on elapsed time and updates sprite texture
 void Animation::update(float deltaTime){
-    if (_frames.empty() || !_sprite) return;
+    if (!_sprite) return;
+    const std::vector<sf::Texture>& frames = _clips[_clip].frames;
     _elapsedTime += deltaTime;
     if (_elapsedTime >= _frameTime){
         _elapsedTime = 0.f;
-        _currentFrame = (_currentFrame + 1) % _frames.size();
-        _sprite->setTexture(_frames[_currentFrame]);
+        _currentFrame = (_currentFrame + 1) % frames.size();
+        _sprite->setTexture(frames[_currentFrame]);
     }
 }
 
+// Shows the given frame, wrapped to the frames of the current direction
+void Animation::setFrame(std::size_t frame){
+    if (!_sprite) return;
+    const std::vector<sf::Texture>& frames = _clips[_clip].frames;
+    frame %= frames.size();
+    if (frame == _currentFrame) return;
+    _currentFrame = frame;
+    _sprite->setTexture(frames[_currentFrame]);
+}
+
 // Returns reference to current animation sprite
 const sf::Sprite& Animation::getSprite() const{
     return *_sprite;
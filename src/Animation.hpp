@@ -2,6 +2,7 @@
 #include <SFML/Graphics.hpp>
 #include <vector>
 #include <string>
+#include "ResourceMemory.hpp"
 
 class Animation{
 public:
@@ -9,7 +10,8 @@ public:
     Animation() = default;
     //constructor for sprites that dont need to change direction with movement
     Animation(const std::string& folderPath, float speed);
-    //constructor for sprites that need to change their direction of animation for moving
+    //constructor for sprites that need to change their direction of animation for moving,
+    //every subfolder is loaded up front as one direction
     Animation(const std::string& folderPath, float speed, bool doesMove);
 
     //loads sprite animation sheets from a specific folder and adds them to a vetor
@@ -18,8 +20,15 @@ public:
     void setSpeed(float speed);
     //updates the animations to the current frame
     void update(float deltaTime);
-    //changes / sets the vector to be the files from the direction directory inside of the base folder
-    void setDirection(const std::string& newDirection, const std::string& baseFolderPath);
+    //shows a frame picked from outside, e.g. by the entity animation pass
+    void setFrame(std::size_t frame);
+    std::size_t getFrameCount() const { return _clips.empty() ? 0 : _clips[_clip].frames.size(); }
+    //switches to the frames of another direction, nothing is loaded
+    void setDirection(const std::string& newDirection);
+    //dev mode hot reload: a changed frame is swapped in place, a frame added to or removed from
+    //a folder reloads the folder. The sprite keeps its place and frame. Returns false
+    //if the file isn't part of this animation
+    bool reloadFile(const std::string& path);
 
     // a getter to display the current animation frame for the sprite
     const sf::Sprite& getSprite() const;
@@ -33,7 +42,22 @@ public:
     
 
 private:
-    std::vector<sf::Texture> _frames;
+    // The frames of one folder, one direction of a directional animation
+    struct Clip {
+        std::string direction; // subfolder name, empty for a single folder
+        std::string folder;
+        std::vector<sf::Texture> frames;
+        std::vector<std::string> framePaths;
+        std::vector<MemoryRecord> frameMemory; // one per frame, counted in the resource memory
+    };
+
+    //(re)loads the frames of the clip's folder, false if there were none
+    static bool loadClip(Clip& clip);
+    //puts the sprite on a frame of a clip
+    void showClip(std::size_t clip, std::size_t frame);
+
+    std::vector<Clip> _clips;
+    std::size_t _clip = 0;
     std::unique_ptr<sf::Sprite> _sprite;
 
     std::string _currentDirection = "right";
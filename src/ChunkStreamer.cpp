@@ -0,0 +1,47 @@
+#include "ChunkStreamer.hpp"
+
+ChunkStreamer::ChunkStreamer(std::shared_ptr<const MapData> map)
+    : _map(std::move(map)), _worker(&ChunkStreamer::run, this){
+}
+
+ChunkStreamer::~ChunkStreamer(){
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stop = true;
+    }
+    _wake.notify_one();
+    _worker.join();
+}
+
+void ChunkStreamer::request(int chunkX, int chunkY){
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _requests.push_back({chunkX, chunkY});
+    }
+    _wake.notify_one();
+}
+
+std::vector<ChunkMesh> ChunkStreamer::collect(){
+    std::lock_guard<std::mutex> lock(_mutex);
+    std::vector<ChunkMesh> finished;
+    finished.swap(_finished);
+    return finished;
+}
+
+// Worker loop: take a request, build it without holding the lock, publish it
+void ChunkStreamer::run(){
+    std::unique_lock<std::mutex> lock(_mutex);
+    while (true){
+        _wake.wait(lock, [this]{ return _stop || !_requests.empty(); });
+        if (_stop) return;
+
+        auto [chunkX, chunkY] = _requests.front();
+        _requests.pop_front();
+
+        lock.unlock();
+        ChunkMesh mesh = buildChunkMesh(*_map, chunkX, chunkY);
+        lock.lock();
+
+        _finished.push_back(std::move(mesh));
+    }
+}
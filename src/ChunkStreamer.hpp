@@ -0,0 +1,40 @@
+#pragma once
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "TileChunk.hpp"
+
+// Background thread that builds chunk render data on request. The TileMap
+// posts the chunks it wants near the camera and picks up finished meshes
+// once per frame
+class ChunkStreamer {
+public:
+    explicit ChunkStreamer(std::shared_ptr<const MapData> map);
+    ~ChunkStreamer();
+
+    ChunkStreamer(const ChunkStreamer&) = delete;
+    ChunkStreamer& operator=(const ChunkStreamer&) = delete;
+
+    // queue a chunk to be built
+    void request(int chunkX, int chunkY);
+
+    // hands back every mesh finished since the last call
+    std::vector<ChunkMesh> collect();
+
+private:
+    void run();
+
+    std::shared_ptr<const MapData> _map;
+    std::mutex _mutex;
+    std::condition_variable _wake;
+    std::deque<std::pair<int, int>> _requests;
+    std::vector<ChunkMesh> _finished;
+    bool _stop = false;
+
+    std::thread _worker; // last, so it starts after everything above exists
+};
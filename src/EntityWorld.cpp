@@ -0,0 +1,307 @@
+#include "EntityWorld.hpp"
+#include "TileMap.hpp"
+#include "AabbBatch.hpp"
+#include <algorithm>
+#include <cmath>
+
+EntityWorld::EntityWorld(std::size_t capacity){
+    posX.resize(capacity);
+    posY.resize(capacity);
+    velX.resize(capacity);
+    velY.resize(capacity);
+    width.resize(capacity);
+    height.resize(capacity);
+    gravity.resize(capacity);
+    groundFriction.resize(capacity);
+    damage.resize(capacity);
+    flags.resize(capacity);
+    frameTime.resize(capacity);
+    frameClock.resize(capacity);
+    frame.resize(capacity);
+    frameCount.resize(capacity);
+
+    _slotToIndex.resize(capacity);
+    _indexToSlot.resize(capacity);
+    _generation.resize(capacity, 1);
+    _cells.resize(capacity);
+    _inGrid.resize(capacity);
+    _lastTested.resize(capacity, 0);
+    _hits.resize(capacity);
+    clear();
+}
+
+EntityHandle EntityWorld::create(const sf::Vector2f& position, const sf::Vector2f& size, float entityGravity, std::uint8_t entityFlags){
+    if (_freeSlots.empty()) return EntityHandle();
+
+    std::uint32_t slot = _freeSlots.back();
+    _freeSlots.pop_back();
+
+    std::size_t i = _count++;
+    _slotToIndex[slot] = static_cast<std::uint32_t>(i);
+    _indexToSlot[i] = slot;
+
+    posX[i] = position.x;
+    posY[i] = position.y;
+    velX[i] = 0.f;
+    velY[i] = 0.f;
+    width[i] = size.x;
+    height[i] = size.y;
+    gravity[i] = entityGravity;
+    groundFriction[i] = 1.f;
+    damage[i] = 0;
+    flags[i] = entityFlags;
+    frameTime[i] = 0.1f;
+    frameClock[i] = 0.f;
+    frame[i] = 0;
+    frameCount[i] = 1;
+
+    return {slot, _generation[slot]};
+}
+
+bool EntityWorld::destroy(EntityHandle handle){
+    if (!isAlive(handle)) return false;
+
+    std::size_t i = _slotToIndex[handle.slot];
+    std::size_t last = --_count;
+    if (i != last){
+        moveEntity(last, i);
+        _indexToSlot[i] = _indexToSlot[last];
+        _slotToIndex[_indexToSlot[i]] = static_cast<std::uint32_t>(i);
+    }
+
+    if (_inGrid[handle.slot]) gridRemove(handle.slot);
+    _generation[handle.slot]++;
+    _freeSlots.push_back(handle.slot);
+    return true;
+}
+
+void EntityWorld::clear(){
+    for (std::size_t i = 0; i < _count; ++i){
+        _generation[_indexToSlot[i]]++;
+    }
+    _count = 0;
+
+    _grid.reset(capacity() * 2);
+    std::fill(_inGrid.begin(), _inGrid.end(), 0);
+
+    // hand slots out lowest first, so the first entity created is slot 0
+    _freeSlots.clear();
+    for (std::size_t slot = capacity(); slot > 0; --slot){
+        _freeSlots.push_back(static_cast<std::uint32_t>(slot - 1));
+    }
+}
+
+bool EntityWorld::isAlive(EntityHandle handle) const{
+    if (handle.slot >= capacity() || _generation[handle.slot] != handle.generation) return false;
+    std::size_t i = _slotToIndex[handle.slot];
+    return i < _count && _indexToSlot[i] == handle.slot;
+}
+
+void EntityWorld::setCellSize(float cellSize){
+    if (cellSize <= 0.f || cellSize == _cellSize) return;
+    _cellSize = cellSize;
+    _grid.reset(capacity() * 2);
+    std::fill(_inGrid.begin(), _inGrid.end(), 0);
+}
+
+void EntityWorld::integrate(float dt){
+    // plain loops over flat arrays, the compiler can vectorise these
+    for (std::size_t i = 0; i < _count; ++i){
+        velY[i] += gravity[i] * dt;
+    }
+    for (std::size_t i = 0; i < _count; ++i){
+        posX[i] += velX[i] * dt;
+        posY[i] += velY[i] * dt;
+    }
+}
+
+void EntityWorld::collideTiles(const TileMap& map){
+    TileContact contacts[MAX_CONTACTS];
+
+    for (std::size_t i = 0; i < _count; ++i){
+        flags[i] &= ~ENTITY_LANDED;
+        damage[i] = 0;
+        if (!(flags[i] & ENTITY_COLLIDES)) continue;
+
+        sf::FloatRect bounds({posX[i], posY[i]}, {width[i], height[i]});
+        std::size_t contactCount = map.queryContacts(bounds, contacts, MAX_CONTACTS);
+
+        // damage comes from the tileset's properties (spikes, lava), a hurt
+        // entity is left where it is for the game to deal with
+        for (std::size_t c = 0; c < contactCount; ++c){
+            damage[i] = std::max(damage[i], contacts[c].properties.damage);
+        }
+        if (damage[i] > 0) continue;
+
+        float fallSpeed = velY[i];
+        const TileProperties* landedOn = nullptr;
+
+        // contacts come deepest first, earlier pushes can clear later ones
+        for (std::size_t c = 0; c < contactCount; ++c){
+            const TileContact& contact = contacts[c];
+            const sf::FloatRect& tileBounds = contact.bounds;
+            if (!contact.properties.solid || !boxesOverlap(bounds, tileBounds)) continue;
+
+            if (contact.normal.y < 0 && velY[i] > 0){
+                // Collision from above
+                posY[i] = tileBounds.position.y - height[i];
+                velY[i] = 0.f;
+                landedOn = &contact.properties;
+            }else if (contact.normal.y > 0 && velY[i] < 0){
+                // Collision from below
+                posY[i] = tileBounds.position.y + tileBounds.size.y;
+                velY[i] = 0.f;
+            }else if (contact.normal.x < 0 && velX[i] > 0){
+                // Collision from left
+                posX[i] = tileBounds.position.x - width[i];
+                velX[i] = 0.f;
+            }else if (contact.normal.x > 0 && velX[i] < 0){
+                // Collision from right
+                posX[i] = tileBounds.position.x + tileBounds.size.x;
+                velX[i] = 0.f;
+            }
+            bounds.position = {posX[i], posY[i]};
+        }
+
+        // Ground behaviour from the tile property table (ice, bounce pads)
+        if (landedOn){
+            flags[i] |= ENTITY_LANDED;
+            groundFriction[i] = landedOn->friction;
+            if (landedOn->bounce > 0.f){
+                velY[i] = -fallSpeed * landedOn->bounce;
+            }
+        }
+    }
+}
+
+void EntityWorld::findOverlaps(std::vector<EntityPair>& pairs){
+    pairs.clear();
+
+    // bring the grid up to date, most bodies stay inside the same cells
+    // from one tick to the next and cost nothing here
+    for (std::size_t i = 0; i < _count; ++i){
+        std::uint32_t slot = _indexToSlot[i];
+        if (!(flags[i] & ENTITY_OVERLAPS)){
+            if (_inGrid[slot]) gridRemove(slot);
+            continue;
+        }
+
+        CellRange range = cellRange(i);
+        if (_inGrid[slot]){
+            const CellRange& old = _cells[slot];
+            if (old.x0 == range.x0 && old.y0 == range.y0 && old.x1 == range.x1 && old.y1 == range.y1) continue;
+            gridRemove(slot);
+        }
+        gridInsert(slot, range);
+    }
+
+    // with only a handful of bodies a batch test of each against the rest
+    // beats walking the grid
+    if (_count <= BATCH_PAIR_LIMIT){
+        for (std::size_t i = 0; i + 1 < _count; ++i){
+            if (!(flags[i] & ENTITY_OVERLAPS)) continue;
+
+            sf::FloatRect bounds({posX[i], posY[i]}, {width[i], height[i]});
+            std::size_t first = i + 1;
+            std::size_t hitCount = overlapBatch(bounds, &posX[first], &posY[first], &width[first], &height[first],
+                                                _count - first, _hits.data());
+            for (std::size_t h = 0; h < hitCount; ++h){
+                std::size_t j = first + _hits[h];
+                if (flags[j] & ENTITY_OVERLAPS) pairs.push_back({i, j});
+            }
+        }
+        return;
+    }
+
+    for (std::size_t i = 0; i < _count; ++i){
+        std::uint32_t slot = _indexToSlot[i];
+        if (!_inGrid[slot]) continue;
+
+        const CellRange& range = _cells[slot];
+        sf::FloatRect bounds({posX[i], posY[i]}, {width[i], height[i]});
+        if (++_query == 0){
+            std::fill(_lastTested.begin(), _lastTested.end(), 0);
+            _query = 1;
+        }
+
+        for (int cy = range.y0; cy <= range.y1; ++cy){
+            for (int cx = range.x0; cx <= range.x1; ++cx){
+                for (std::uint32_t otherSlot : _grid.getBucket(cx, cy)){
+                    // each pair once, from the lower slot
+                    if (otherSlot <= slot) continue;
+
+                    // and each body once per query. It shows up again in
+                    // every shared cell, and more than once in a bucket when
+                    // several of its cells hash there
+                    if (_lastTested[otherSlot] == _query) continue;
+                    _lastTested[otherSlot] = _query;
+
+                    // bodies just in the bucket from another cell fail the box test
+                    std::size_t j = _slotToIndex[otherSlot];
+                    sf::FloatRect otherBounds({posX[j], posY[j]}, {width[j], height[j]});
+                    if (boxesOverlap(bounds, otherBounds)){
+                        pairs.push_back({i, j});
+                    }
+                }
+            }
+        }
+    }
+}
+
+void EntityWorld::animate(float dt){
+    for (std::size_t i = 0; i < _count; ++i){
+        frameClock[i] += dt;
+    }
+    for (std::size_t i = 0; i < _count; ++i){
+        if (frameClock[i] >= frameTime[i]){
+            frameClock[i] = 0.f;
+            frame[i] = static_cast<std::uint16_t>((frame[i] + 1) % std::max<std::uint16_t>(frameCount[i], 1));
+        }
+    }
+}
+
+void EntityWorld::moveEntity(std::size_t from, std::size_t to){
+    posX[to] = posX[from];
+    posY[to] = posY[from];
+    velX[to] = velX[from];
+    velY[to] = velY[from];
+    width[to] = width[from];
+    height[to] = height[from];
+    gravity[to] = gravity[from];
+    groundFriction[to] = groundFriction[from];
+    damage[to] = damage[from];
+    flags[to] = flags[from];
+    frameTime[to] = frameTime[from];
+    frameClock[to] = frameClock[from];
+    frame[to] = frame[from];
+    frameCount[to] = frameCount[from];
+}
+
+EntityWorld::CellRange EntityWorld::cellRange(std::size_t index) const{
+    CellRange range;
+    range.x0 = static_cast<int>(std::floor(posX[index] / _cellSize));
+    range.y0 = static_cast<int>(std::floor(posY[index] / _cellSize));
+    range.x1 = static_cast<int>(std::floor((posX[index] + width[index]) / _cellSize));
+    range.y1 = static_cast<int>(std::floor((posY[index] + height[index]) / _cellSize));
+    return range;
+}
+
+void EntityWorld::gridInsert(std::uint32_t slot, const CellRange& range){
+    for (int cy = range.y0; cy <= range.y1; ++cy){
+        for (int cx = range.x0; cx <= range.x1; ++cx){
+            _grid.insert(slot, cx, cy);
+        }
+    }
+    _cells[slot] = range;
+    _inGrid[slot] = 1;
+}
+
+void EntityWorld::gridRemove(std::uint32_t slot){
+    const CellRange& range = _cells[slot];
+    for (int cy = range.y0; cy <= range.y1; ++cy){
+        for (int cx = range.x0; cx <= range.x1; ++cx){
+            _grid.remove(slot, cx, cy);
+        }
+    }
+    _inGrid[slot] = 0;
+}
@@ -0,0 +1,143 @@
+#pragma once
+#include <SFML/Graphics.hpp>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+#include "SpatialHash.hpp"
+
+class TileMap;
+
+// Refers to an entity across swaps and reuse of its storage. A handle goes
+// stale once its entity is destroyed, even if the slot is handed out again
+struct EntityHandle {
+    std::uint32_t slot = 0xFFFFFFFF;
+    std::uint32_t generation = 0;
+};
+
+// Per entity flags
+enum EntityFlag : std::uint8_t {
+    ENTITY_COLLIDES = 1 << 0, // pushed out of collision tiles
+    ENTITY_LANDED   = 1 << 1, // set by collideTiles when it landed this tick
+    ENTITY_OVERLAPS = 1 << 2  // reported by findOverlaps when touching another
+};
+
+// Two overlapping entities, as indices into the component arrays
+struct EntityPair {
+    std::size_t a = 0;
+    std::size_t b = 0;
+};
+
+// Every dynamic object in a level (player, enemies, projectiles, moving
+// hazards) with its components stored as one array per field. Live entities
+// are packed at the front of the arrays, so each system pass is a straight
+// loop over [0, size()) with no pointer chasing or per entity branching
+// on type.
+//
+// Storage for capacity entities is allocated once up front and reused, so
+// creating and destroying entities never allocates and component references
+// stay valid until an entity is destroyed (which moves the last one down)
+class EntityWorld {
+public:
+    static const std::size_t DEFAULT_CAPACITY = 1024;
+
+    explicit EntityWorld(std::size_t capacity = DEFAULT_CAPACITY);
+
+    // Adds an entity standing still at position. Returns a handle that is
+    // never alive if the pool is full
+    EntityHandle create(const sf::Vector2f& position, const sf::Vector2f& size, float gravity, std::uint8_t entityFlags);
+
+    // Removes an entity, the last one is moved into its place
+    bool destroy(EntityHandle handle);
+
+    // Removes every entity, all outstanding handles go stale
+    void clear();
+
+    bool isAlive(EntityHandle handle) const;
+
+    // Position of a live entity in the component arrays. Only valid until
+    // the next destroy
+    std::size_t indexOf(EntityHandle handle) const { return _slotToIndex[handle.slot]; }
+
+    std::size_t size() const { return _count; }
+    std::size_t capacity() const { return _indexToSlot.size(); }
+
+    // Size of the broadphase grid cells, best kept a multiple of the map's
+    // tile size. Rebuilds the grid on the next findOverlaps
+    void setCellSize(float cellSize);
+
+    // Systems, run in this order once per tick
+
+    // Applies gravity and moves every entity by its velocity
+    void integrate(float dt);
+
+    // Pushes colliding entities out of the map's collision tiles and records
+    // the damage and ground properties of what they touched
+    void collideTiles(const TileMap& map);
+
+    // Replaces pairs with every pair of ENTITY_OVERLAPS entities whose boxes
+    // overlap. Entities sit in a hashed grid and are only re-bucketed when
+    // they cross a cell edge, then each is tested against the bodies sharing
+    // its cells, so the cost grows with the number of bodies rather than
+    // the number of pairs
+    void findOverlaps(std::vector<EntityPair>& pairs);
+
+    // Advances every entity's animation clock and frame
+    void animate(float dt);
+
+    // Components, indexed by indexOf, entries past size() are unused
+    std::vector<float> posX;
+    std::vector<float> posY;
+    std::vector<float> velX;
+    std::vector<float> velY;
+    std::vector<float> width;
+    std::vector<float> height;
+    std::vector<float> gravity;        // downward acceleration, 0 for floating things
+    std::vector<float> groundFriction; // friction of the last tile landed on
+    std::vector<int> damage;           // most damage touched in the last collideTiles
+    std::vector<std::uint8_t> flags;
+
+    // Animation, frames advance every frameTime seconds and wrap at frameCount
+    std::vector<float> frameTime;
+    std::vector<float> frameClock;
+    std::vector<std::uint16_t> frame;
+    std::vector<std::uint16_t> frameCount;
+
+private:
+    std::size_t _count = 0;
+
+    // Handle slots map to array positions and back, so entities can be moved
+    // around to stay packed while handles keep working
+    std::vector<std::uint32_t> _slotToIndex;
+    std::vector<std::uint32_t> _indexToSlot;
+    std::vector<std::uint32_t> _generation;
+    std::vector<std::uint32_t> _freeSlots;
+
+    // Broadphase, the cells each slot was last inserted over
+    struct CellRange {
+        int x0 = 0;
+        int y0 = 0;
+        int x1 = -1;
+        int y1 = -1;
+    };
+    float _cellSize = 64.f;
+    SpatialHash _grid;
+    std::vector<CellRange> _cells;
+    std::vector<std::uint8_t> _inGrid;
+    std::vector<std::uint32_t> _lastTested; // query stamp per slot, dedupes bodies met in several cells
+    std::uint32_t _query = 0;
+
+    // Worlds this small test every pair with the batch box test instead
+    // of walking the grid
+    static const std::size_t BATCH_PAIR_LIMIT = 64;
+
+    // Scratch space for the batch box test, sized to capacity
+    std::vector<std::uint32_t> _hits;
+
+    CellRange cellRange(std::size_t index) const;
+    void gridInsert(std::uint32_t slot, const CellRange& range);
+    void gridRemove(std::uint32_t slot);
+
+    // Copies every component of one entity over another
+    void moveEntity(std::size_t from, std::size_t to);
+};
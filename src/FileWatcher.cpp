@@ -0,0 +1,108 @@
+#include "FileWatcher.hpp"
+#include "Log.hpp"
+#include <filesystem>
+
+#if defined(__linux__)
+#include <sys/inotify.h>
+#include <unistd.h>
+#include <cstdint>
+#endif
+
+namespace fs = std::filesystem;
+
+#if defined(__linux__)
+
+static const std::uint32_t WATCH_MASK = IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE | IN_DELETE;
+
+FileWatcher::~FileWatcher(){
+    if (_fd >= 0) close(_fd);
+}
+
+bool FileWatcher::watch(const std::string& root){
+    if (_fd < 0){
+        _fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (_fd < 0){
+            LOG_WARNING("inotify unavailable, not watching " << root);
+            return false;
+        }
+    }
+
+    std::error_code error;
+    if (!fs::is_directory(root, error)){
+        LOG_WARNING("Can't watch " << root << ", not a directory");
+        return false;
+    }
+    addDirectory(root);
+    for (auto it = fs::recursive_directory_iterator(root, error); !error && it != fs::recursive_directory_iterator(); it.increment(error)){
+        if (it->is_directory(error)) addDirectory(it->path().string());
+    }
+    LOG_INFO("Watching " << _directories.size() << " directories under " << root << " for changes");
+    return true;
+}
+
+void FileWatcher::addDirectory(const std::string& directory){
+    int wd = inotify_add_watch(_fd, directory.c_str(), WATCH_MASK);
+    if (wd < 0){
+        LOG_WARNING("Failed to watch " << directory);
+        return;
+    }
+    _directories[wd] = directory;
+}
+
+std::vector<std::string> FileWatcher::poll(){
+    std::vector<std::string> settled;
+    if (_fd < 0) return settled;
+
+    // Drain every event the kernel has queued
+    alignas(inotify_event) char buffer[4096];
+    Clock::time_point now = Clock::now();
+    while (true){
+        ssize_t length = read(_fd, buffer, sizeof(buffer));
+        if (length <= 0) break; // EAGAIN, nothing more for now
+
+        for (char* at = buffer; at < buffer + length;){
+            const inotify_event* event = reinterpret_cast<const inotify_event*>(at);
+            at += sizeof(inotify_event) + event->len;
+
+            auto directory = _directories.find(event->wd);
+            if (directory == _directories.end() || event->len == 0) continue;
+            std::string path = directory->second + "/" + event->name;
+
+            if (event->mask & IN_ISDIR){
+                // new folders (e.g. a new animation clip) are watched too
+                if (event->mask & (IN_CREATE | IN_MOVED_TO)) addDirectory(path);
+                continue;
+            }
+            _pending[path] = now;
+        }
+    }
+
+    for (auto it = _pending.begin(); it != _pending.end();){
+        if (now - it->second >= SETTLE_TIME){
+            settled.push_back(it->first);
+            it = _pending.erase(it);
+        }
+        else {
+            ++it;
+        }
+    }
+    return settled;
+}
+
+#else
+
+FileWatcher::~FileWatcher() = default;
+
+bool FileWatcher::watch(const std::string& root){
+    LOG_WARNING("File watching needs inotify, not watching " << root);
+    return false;
+}
+
+void FileWatcher::addDirectory(const std::string&){
+}
+
+std::vector<std::string> FileWatcher::poll(){
+    return {};
+}
+
+#endif
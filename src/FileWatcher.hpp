@@ -0,0 +1,38 @@
+#pragma once
+#include <chrono>
+#include <map>
+#include <string>
+#include <vector>
+
+// Reports files written under a directory tree, for hot reloading assets
+// in dev mode. Uses inotify on Linux, every subdirectory gets its own watch
+// since inotify isn't recursive. Elsewhere watch() fails and nothing is
+// ever reported
+class FileWatcher {
+public:
+    // Editors and exporters often write a file in several goes, a path is
+    // reported once it has been quiet this long
+    static constexpr std::chrono::milliseconds SETTLE_TIME{150};
+
+    FileWatcher() = default;
+    ~FileWatcher();
+
+    FileWatcher(const FileWatcher&) = delete;
+    FileWatcher& operator=(const FileWatcher&) = delete;
+
+    // Starts watching root and everything below it
+    bool watch(const std::string& root);
+
+    // Files written, created, moved in or deleted since the last call that
+    // have settled, never blocks
+    std::vector<std::string> poll();
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    int _fd = -1;
+    std::map<int, std::string> _directories;    // watch descriptor to path
+    std::map<std::string, Clock::time_point> _pending;
+
+    void addDirectory(const std::string& directory);
+};
@@ -0,0 +1,66 @@
+#include "FrameArena.hpp"
+#include "Log.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <new>
+
+FrameArena::FrameArena(std::size_t capacity)
+    : _block(new std::byte[capacity]), _capacity(capacity){
+}
+
+FrameArena::~FrameArena(){
+    freeOverflow();
+}
+
+void* FrameArena::do_allocate(std::size_t bytes, std::size_t alignment){
+    std::uintptr_t base = (std::uintptr_t)_block.get();
+    std::uintptr_t start = (base + _used + alignment - 1) & ~(std::uintptr_t)(alignment - 1);
+    if (start - base + bytes <= _capacity){
+        _used = start - base + bytes;
+        return (void*)start;
+    }
+
+    // Full, borrow from the heap until the next reset
+    alignment = std::max(alignment, alignof(Overflow));
+    std::size_t header = (sizeof(Overflow) + alignment - 1) & ~(alignment - 1);
+    std::size_t size = header + bytes;
+    void* memory = std::pmr::new_delete_resource()->allocate(size, alignment);
+    _overflow = new (memory) Overflow{_overflow, size, alignment};
+    _overflowBytes += size;
+    return (std::byte*)memory + header;
+}
+
+void FrameArena::freeOverflow(){
+    while (_overflow){
+        Overflow* next = _overflow->next;
+        std::pmr::new_delete_resource()->deallocate(_overflow, _overflow->size, _overflow->alignment);
+        _overflow = next;
+    }
+}
+
+void FrameArena::reset(){
+    std::size_t frameBytes = _used + _overflowBytes;
+    _highWater = std::max(_highWater, frameBytes);
+
+    // Grow to twice the block, or to 1.5x what this frame needed if that
+    // is more, so the next frame like it fits in the block
+    if (_overflow){
+        freeOverflow();
+        _capacity = std::max(_capacity * 2, frameBytes + frameBytes / 2);
+        _block.reset(new std::byte[_capacity]);
+    }
+    _used = 0;
+    _overflowBytes = 0;
+}
+
+void FrameArenas::beginFrame(){
+    _current ^= 1;
+    _arenas[_current].reset();
+}
+
+void FrameArenas::logStats(const std::string& label) const{
+    for (const auto& arena : _arenas){
+        LOG_INFO(label << " frame arena: " << arena.getHighWater() / 1024.f << " KB used at most, "
+                 << arena.getCapacity() / 1024 << " KB block");
+    }
+}
@@ -0,0 +1,69 @@
+#pragma once
+#include <cstddef>
+#include <memory>
+#include <memory_resource>
+#include <string>
+
+// Bump allocator for data that only lives for a frame, usable by the pmr
+// containers (std::pmr::vector, std::pmr::string). Allocating moves a
+// pointer along one block, freeing does nothing and reset() drops the lot
+// at once. A frame that outgrows the block gets the rest from the heap and
+// at the next reset the block grows to twice its size, or to 1.5x what that
+// frame needed if more, so steady frames stay off the heap.
+// One thread only
+class FrameArena : public std::pmr::memory_resource {
+public:
+    static const std::size_t DEFAULT_CAPACITY = 64 * 1024;
+
+    explicit FrameArena(std::size_t capacity = DEFAULT_CAPACITY);
+    ~FrameArena() override;
+
+    FrameArena(const FrameArena&) = delete;
+    FrameArena& operator=(const FrameArena&) = delete;
+
+    // Everything handed out since the last reset is gone
+    void reset();
+
+    std::size_t getCapacity() const { return _capacity; }
+    // Most bytes one frame asked for, heap overflow included
+    std::size_t getHighWater() const { return _highWater; }
+
+private:
+    // Header in front of each heap block a full arena hands out
+    struct Overflow {
+        Overflow* next;
+        std::size_t size;
+        std::size_t alignment;
+    };
+
+    std::unique_ptr<std::byte[]> _block;
+    std::size_t _capacity = 0;
+    std::size_t _used = 0;
+    std::size_t _overflowBytes = 0;
+    std::size_t _highWater = 0;
+    Overflow* _overflow = nullptr;
+
+    void* do_allocate(std::size_t bytes, std::size_t alignment) override;
+    void do_deallocate(void*, std::size_t, std::size_t) override {} // all freed by reset
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override { return this == &other; }
+
+    void freeOverflow();
+};
+
+// Two arenas taking turns, so what one frame builds stays valid until the
+// end of the next (built while updating, still there while the following
+// frame draws)
+class FrameArenas {
+public:
+    // Switch to the other arena and empty it, call at the start of every frame
+    void beginFrame();
+
+    std::pmr::memory_resource* get() { return &_arenas[_current]; }
+
+    // High water marks of both arenas
+    void logStats(const std::string& label) const;
+
+private:
+    FrameArena _arenas[2];
+    int _current = 0;
+};
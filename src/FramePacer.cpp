@@ -0,0 +1,162 @@
+#include "FramePacer.hpp"
+#include "Log.hpp"
+#include <algorithm>
+#include <cmath>
+#include <thread>
+
+// Bounds for the sleep slack, spinning more than a few ms just burns a core
+static const std::chrono::microseconds MIN_SLACK(250);
+static const std::chrono::microseconds MAX_SLACK(4000);
+
+FramePacer::FramePacer(unsigned rate)
+    : _history(HISTORY){
+    setTargetRate(rate);
+    setSmoothing(4);
+}
+
+void FramePacer::setTargetRate(unsigned rate){
+    _rate = rate;
+    _period = rate > 0 ? std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / rate))
+                       : Clock::duration::zero();
+}
+
+void FramePacer::setSmoothing(std::size_t frames){
+    _smoothing.assign(std::max<std::size_t>(frames, 1), 0.f);
+    _smoothingNext = 0;
+    _smoothingCount = 0;
+}
+
+float FramePacer::nominalDt() const{
+    if (_rate > 0) return 1.f / _rate;
+    if (_smoothingCount == 0) return 1.f / 60.f;
+    float sum = 0.f;
+    for (std::size_t i = 0; i < _smoothingCount; ++i) sum += _smoothing[i];
+    return sum / _smoothingCount;
+}
+
+void FramePacer::waitUntil(Clock::time_point deadline){
+    for (;;){
+        Clock::time_point now = Clock::now();
+        if (now >= deadline) return;
+
+        Clock::duration remaining = deadline - now;
+        if (remaining > _sleepSlack){
+            Clock::duration request = remaining - _sleepSlack;
+            std::this_thread::sleep_for(request);
+
+            // keep the slack just above the worst recent overshoot, it
+            // shrinks again slowly once sleeps get more accurate
+            Clock::duration overshoot = Clock::now() - now - request;
+            _sleepSlack = std::max(_sleepSlack - _sleepSlack / 64, overshoot + overshoot / 4);
+            _sleepSlack = std::clamp<Clock::duration>(_sleepSlack, MIN_SLACK, MAX_SLACK);
+        }
+        else {
+            std::this_thread::yield();
+        }
+    }
+}
+
+float FramePacer::tick(){
+    Clock::time_point now = Clock::now();
+    if (!_started){
+        _started = true;
+        _resetPending = false;
+        _lastTick = now;
+        _deadline = now;
+        return nominalDt();
+    }
+
+    if (!_vsync && _rate > 0){
+        _deadline += _period;
+        if (now > _deadline + _period){
+            _deadline = now; // too far behind, start a new schedule
+        }
+        else {
+            waitUntil(_deadline);
+            now = Clock::now();
+        }
+    }
+
+    float frameTime = std::chrono::duration<float>(now - _lastTick).count();
+    _lastTick = now;
+
+    if (_resetPending){
+        _resetPending = false;
+        float dt = nominalDt();
+        _smoothingNext = _smoothingCount = 0;
+        return dt;
+    }
+
+    _history[_historyNext] = frameTime * 1000.f;
+    _historyNext = (_historyNext + 1) % _history.size();
+    _historyCount = std::min(_historyCount + 1, _history.size());
+
+    if (frameTime > MAX_FRAME_TIME) return nominalDt();
+
+    _smoothing[_smoothingNext] = frameTime;
+    _smoothingNext = (_smoothingNext + 1) % _smoothing.size();
+    _smoothingCount = std::min(_smoothingCount + 1, _smoothing.size());
+
+    float dt = 0.f;
+    for (std::size_t i = 0; i < _smoothingCount; ++i) dt += _smoothing[i];
+    dt /= _smoothingCount;
+
+    // Close to the target means on schedule, the exact period keeps
+    // motion even instead of following the timer's noise
+    if (_rate > 0){
+        float period = 1.f / _rate;
+        if (std::abs(dt - period) < period * 0.1f) return period;
+    }
+    return dt;
+}
+
+void FramePacer::reset(){
+    _resetPending = true;
+}
+
+FrameStats FramePacer::getStats() const{
+    FrameStats stats;
+    stats.frames = _historyCount;
+    if (_historyCount == 0) return stats;
+
+    std::vector<float> times(_history.begin(), _history.begin() + _historyCount);
+    std::sort(times.begin(), times.end());
+
+    auto percentile = [&](float p){
+        std::size_t rank = (std::size_t)std::ceil(p * times.size());
+        return times[std::clamp<std::size_t>(rank, 1, times.size()) - 1];
+    };
+    stats.p50 = percentile(0.50f);
+    stats.p95 = percentile(0.95f);
+    stats.p99 = percentile(0.99f);
+    stats.max = times.back();
+
+    float sum = 0.f;
+    for (float t : times) sum += t;
+    stats.mean = sum / times.size();
+
+    float variance = 0.f;
+    for (float t : times) variance += (t - stats.mean) * (t - stats.mean);
+    stats.jitter = std::sqrt(variance / times.size());
+
+    if (_rate > 0){
+        float limit = 1500.f / _rate;
+        stats.missed = times.end() - std::upper_bound(times.begin(), times.end(), limit);
+    }
+    return stats;
+}
+
+void FramePacer::logStats(const char* label) const{
+    FrameStats stats = getStats();
+    if (stats.frames == 0) return;
+
+    if (!Log::isEnabled(LogLevel::INFO)) return;
+    LogLine line(LogLevel::INFO);
+    line << "Frame times (" << label << ", last " << stats.frames << " frames, ";
+    if (_rate > 0) line << _rate << " Hz";
+    else line << "unlocked";
+    if (_vsync) line << " vsync";
+    line << "): p50 " << stats.p50 << " ms, p95 " << stats.p95 << " ms, p99 " << stats.p99
+         << " ms, max " << stats.max << " ms, jitter " << stats.jitter << " ms, "
+         << stats.missed << " missed";
+}
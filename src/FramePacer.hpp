@@ -0,0 +1,89 @@
+#pragma once
+#include <chrono>
+#include <cstddef>
+#include <vector>
+
+// Frame times over the recent history, in milliseconds
+struct FrameStats {
+    std::size_t frames = 0;
+    float mean = 0.f;
+    float p50 = 0.f;
+    float p95 = 0.f;
+    float p99 = 0.f;
+    float max = 0.f;
+    float jitter = 0.f;         // standard deviation
+    std::size_t missed = 0;     // frames that took over 1.5 target periods
+};
+
+// Paces the main loop to a fixed rate and hands out the frame's dt. Call
+// tick() once at the top of every loop iteration, right after the previous
+// display(): it waits out the rest of the frame by sleeping most of it and
+// spinning the last bit, which lands within a few microseconds of the
+// deadline where a plain sleep can overshoot by a millisecond or more.
+// Input is polled right after the wait, so the time from input to the
+// frame being shown stays the same frame to frame.
+//
+// Deadlines follow a fixed schedule so small overshoots don't add up; a
+// loop more than a frame behind starts a new schedule instead of rushing
+// to catch up. In vsync mode the driver blocks in display() and the pacer
+// only measures
+class FramePacer {
+public:
+    // Frames kept for the statistics
+    static const std::size_t HISTORY = 600;
+    // Frames longer than this are hitches (loading, window drags), their dt
+    // is replaced by the target period so the simulation doesn't jump
+    static constexpr float MAX_FRAME_TIME = 0.1f;
+
+    // rate in Hz, 0 for unlocked
+    explicit FramePacer(unsigned rate = 60);
+
+    void setTargetRate(unsigned rate);
+    unsigned getTargetRate() const { return _rate; }
+
+    // The window's vsync has to be switched on separately, rate should then
+    // be the display's refresh rate
+    void setVsync(bool enabled) { _vsync = enabled; }
+    bool isVsync() const { return _vsync; }
+
+    // dt is averaged over this many frames, 1 turns smoothing off
+    void setSmoothing(std::size_t frames);
+
+    // Waits for the next frame and returns its dt in seconds
+    float tick();
+
+    // Call after anything that stalls the loop on purpose (state changes,
+    // level loads), the next dt is one target period and the stall is left
+    // out of the statistics
+    void reset();
+
+    FrameStats getStats() const;
+
+    // One line of stats on stdout
+    void logStats(const char* label) const;
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    unsigned _rate = 60;
+    bool _vsync = false;
+    Clock::duration _period{};
+    Clock::time_point _deadline;
+    Clock::time_point _lastTick;
+    bool _started = false;
+    bool _resetPending = false;
+
+    // How much sleeps overshoot, the last stretch before a deadline is spun
+    Clock::duration _sleepSlack = std::chrono::milliseconds(1);
+
+    std::vector<float> _smoothing;  // recent dt, seconds
+    std::size_t _smoothingNext = 0;
+    std::size_t _smoothingCount = 0;
+
+    std::vector<float> _history;    // recent frame times, milliseconds
+    std::size_t _historyNext = 0;
+    std::size_t _historyCount = 0;
+
+    float nominalDt() const;
+    void waitUntil(Clock::time_point deadline);
+};
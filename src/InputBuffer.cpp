@@ -0,0 +1,136 @@
+#include "InputBuffer.hpp"
+
+InputBuffer::InputBuffer(){
+    using Key = sf::Keyboard::Scancode;
+    bind(Key::A, Action::LEFT);
+    bind(Key::D, Action::RIGHT);
+    bind(Key::W, Action::JUMP);
+    bind(Key::K, Action::JUMP);
+    bind(Key::S, Action::CROUCH);
+    bind(Key::E, Action::DASH_RIGHT);
+    bind(Key::L, Action::DASH_RIGHT);
+    bind(Key::Q, Action::DASH_LEFT);
+    bind(Key::J, Action::DASH_LEFT);
+    bind(Key::Enter, Action::CONFIRM);
+}
+
+void InputBuffer::bind(sf::Keyboard::Scancode key, Action action){
+    std::lock_guard<std::mutex> lock(_mutex);
+    _bindings.push_back({key, action});
+}
+
+bool InputBuffer::handleEvent(const sf::Event& event){
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (event.is<sf::Event::FocusLost>()){
+        releaseAll();
+        return false;
+    }
+
+    bool pressed;
+    sf::Keyboard::Scancode key;
+    if (const auto* keyPressed = event.getIf<sf::Event::KeyPressed>()){
+        pressed = true;
+        key = keyPressed->scancode;
+    }
+    else if (const auto* keyReleased = event.getIf<sf::Event::KeyReleased>()){
+        pressed = false;
+        key = keyReleased->scancode;
+    }
+    else {
+        return false;
+    }
+
+    bool bound = false;
+    sf::Time time = now();
+    for (auto& binding : _bindings){
+        if (binding.key != key) continue;
+        bound = true;
+        // repeats of a held key, or a release we never saw the press of
+        if (binding.down == pressed) continue;
+        binding.down = pressed;
+        push({binding.action, pressed, time});
+    }
+    return bound;
+}
+
+// push, apply and releaseAll are only called with the lock held
+
+void InputBuffer::push(const InputEvent& event){
+    // full, the oldest event lands in the current tick rather than being lost
+    if (_count == CAPACITY){
+        apply(_events[_head]);
+        _head = (_head + 1) % CAPACITY;
+        --_count;
+    }
+    _events[(_head + _count) % CAPACITY] = event;
+    ++_count;
+}
+
+void InputBuffer::apply(const InputEvent& event){
+    ActionState& state = _actions[(std::size_t)event.action];
+    if (event.pressed){
+        if (state.keysDown++ == 0){
+            state.pressed = true;
+            state.buffered = true;
+            state.lastPress = event.time;
+        }
+    }
+    else if (state.keysDown > 0 && --state.keysDown == 0){
+        state.released = true;
+    }
+}
+
+void InputBuffer::advance(sf::Time until){
+    std::lock_guard<std::mutex> lock(_mutex);
+    for (auto& state : _actions){
+        state.pressed = false;
+        state.released = false;
+    }
+    while (_count > 0 && _events[_head].time <= until){
+        apply(_events[_head]);
+        _head = (_head + 1) % CAPACITY;
+        --_count;
+    }
+    _tickEnd = until;
+}
+
+void InputBuffer::releaseAll(){
+    sf::Time time = now();
+    for (auto& binding : _bindings){
+        if (!binding.down) continue;
+        binding.down = false;
+        push({binding.action, false, time});
+    }
+}
+
+void InputBuffer::clear(){
+    std::lock_guard<std::mutex> lock(_mutex);
+    for (auto& binding : _bindings) binding.down = false;
+    _actions = {};
+    _head = 0;
+    _count = 0;
+}
+
+bool InputBuffer::held(Action action) const{
+    std::lock_guard<std::mutex> lock(_mutex);
+    const ActionState& state = _actions[(std::size_t)action];
+    return state.keysDown > 0 || state.pressed;
+}
+
+bool InputBuffer::pressed(Action action) const{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _actions[(std::size_t)action].pressed;
+}
+
+bool InputBuffer::released(Action action) const{
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _actions[(std::size_t)action].released;
+}
+
+bool InputBuffer::consumeBuffered(Action action, sf::Time window){
+    std::lock_guard<std::mutex> lock(_mutex);
+    ActionState& state = _actions[(std::size_t)action];
+    if (!state.buffered) return false;
+    state.buffered = false;
+    return _tickEnd - state.lastPress <= window;
+}
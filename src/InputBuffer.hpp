@@ -0,0 +1,101 @@
+#pragma once
+#include <SFML/Window.hpp>
+#include <SFML/System.hpp>
+#include <array>
+#include <cstddef>
+#include <mutex>
+#include <vector>
+
+// Things the player can do, several keys can map to one action
+enum class Action {
+    LEFT,
+    RIGHT,
+    JUMP,
+    CROUCH,
+    DASH_RIGHT,
+    DASH_LEFT,
+    CONFIRM,
+    COUNT
+};
+
+// One key going down or up, stamped when it was taken off the event queue
+struct InputEvent {
+    Action action = Action::COUNT;
+    bool pressed = false;
+    sf::Time time;
+};
+
+// Keyboard input from KeyPressed/KeyReleased events instead of polling
+// isKeyPressed once a frame. Events are stamped into a ring buffer as they
+// are polled and folded into per-action state a tick at a time, so a tick
+// sees every press and release that happened in its interval: a tap shorter
+// than a frame still counts, and presses are edges rather than held keys.
+// Presses also stay buffered for a short window so an action pressed a
+// little early (a jump just before landing) still goes through.
+//
+// Events can be fed from the window's thread while a simulation thread
+// advances and reads the state, every call takes the buffer's lock
+class InputBuffer {
+public:
+    // Events waiting to be folded in, only a long stall fills this
+    static const std::size_t CAPACITY = 256;
+
+    // Default bindings: A/D move, W/K jump, S crouch, E/L and Q/J dash,
+    // Enter confirms
+    InputBuffer();
+
+    void bind(sf::Keyboard::Scancode key, Action action);
+
+    // Feed every event from pollEvent, returns true if it was a bound key.
+    // Key repeats are dropped and losing focus releases everything
+    bool handleEvent(const sf::Event& event);
+
+    // Fold the events up to until into the tick state, call once per tick
+    // after polling. Pressed and released only last for that one tick
+    void advance(sf::Time until);
+    void advance() { advance(now()); }
+
+    // Forget everything, for state changes where the keys were read elsewhere
+    void clear();
+
+    sf::Time now() const { return _clock.getElapsedTime(); }
+
+    // Down at the end of the tick, or tapped during it
+    bool held(Action action) const;
+    // Went down / up during the tick
+    bool pressed(Action action) const;
+    bool released(Action action) const;
+
+    // True once for a press no older than window at the end of the tick,
+    // the press is used up. For actions that may have to wait a moment
+    bool consumeBuffered(Action action, sf::Time window);
+
+private:
+    struct Binding {
+        sf::Keyboard::Scancode key;
+        Action action;
+        bool down = false;
+    };
+
+    struct ActionState {
+        int keysDown = 0;
+        bool pressed = false;
+        bool released = false;
+        bool buffered = false;  // press not used by consumeBuffered yet
+        sf::Time lastPress;
+    };
+
+    mutable std::mutex _mutex;
+    sf::Clock _clock;
+    sf::Time _tickEnd;
+    std::vector<Binding> _bindings;
+    std::array<ActionState, (std::size_t)Action::COUNT> _actions{};
+
+    std::array<InputEvent, CAPACITY> _events{};
+    std::size_t _head = 0;
+    std::size_t _count = 0;
+
+    void push(const InputEvent& event);
+    void apply(const InputEvent& event);
+    void releaseAll();
+};
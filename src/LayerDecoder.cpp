@@ -0,0 +1,165 @@
+#include "LayerDecoder.hpp"
+#include "Log.hpp"
+
+#include <array>
+#include <cctype>
+#include <cstring>
+#include <zlib.h>
+#ifdef USE_ZSTD
+#include <zstd.h>
+#endif
+
+namespace {
+
+// 0xFF marks characters that are not part of the base64 alphabet
+std::array<std::uint8_t, 256> makeBase64Table(){
+    std::array<std::uint8_t, 256> table;
+    table.fill(0xFF);
+    const char* alphabet = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    for (int i = 0; i < 64; ++i){
+        table[(std::uint8_t)alphabet[i]] = (std::uint8_t)i;
+    }
+    return table;
+}
+
+// Decodes base64 into out, which must hold at least (text.size() * 3 + 3) / 4
+// bytes. Returns the number of bytes written, or -1 on a bad character
+long base64Decode(const std::string& text, std::uint8_t* out){
+    static const std::array<std::uint8_t, 256> table = makeBase64Table();
+
+    // Tiled pads with '=' and may wrap lines with whitespace
+    std::size_t length = text.size();
+    while (length > 0 && (text[length - 1] == '=' || std::isspace((unsigned char)text[length - 1]))){
+        --length;
+    }
+
+    const std::uint8_t* in = (const std::uint8_t*)text.data();
+    std::uint8_t* start = out;
+    std::uint32_t bits = 0;
+    int count = 0;
+    std::size_t i = 0;
+
+    // Fast path: four clean characters to three bytes at a time
+    for (; i + 4 <= length; i += 4){
+        std::uint32_t a = table[in[i]], b = table[in[i + 1]], c = table[in[i + 2]], d = table[in[i + 3]];
+        if ((a | b | c | d) & 0x80) break; // whitespace or garbage, let the slow loop sort it out
+        std::uint32_t word = (a << 18) | (b << 12) | (c << 6) | d;
+        out[0] = (std::uint8_t)(word >> 16);
+        out[1] = (std::uint8_t)(word >> 8);
+        out[2] = (std::uint8_t)word;
+        out += 3;
+    }
+
+    for (; i < length; ++i){
+        std::uint8_t value = table[in[i]];
+        if (value == 0xFF){
+            if (std::isspace(in[i])) continue;
+            return -1;
+        }
+        bits = (bits << 6) | value;
+        if (++count == 4){
+            out[0] = (std::uint8_t)(bits >> 16);
+            out[1] = (std::uint8_t)(bits >> 8);
+            out[2] = (std::uint8_t)bits;
+            out += 3;
+            bits = 0;
+            count = 0;
+        }
+    }
+    if (count == 2){
+        *out++ = (std::uint8_t)(bits >> 4);
+    } else if (count == 3){
+        *out++ = (std::uint8_t)(bits >> 10);
+        *out++ = (std::uint8_t)(bits >> 2);
+    } else if (count == 1){
+        return -1;
+    }
+    return (long)(out - start);
+}
+
+// Inflates zlib or gzip data (zlib picks by header) into dest
+bool inflateInto(const std::uint8_t* src, std::size_t srcSize, std::uint8_t* dest, std::size_t destSize){
+    z_stream stream;
+    std::memset(&stream, 0, sizeof(stream));
+    if (inflateInit2(&stream, 15 + 32) != Z_OK) return false;
+
+    stream.next_in = const_cast<Bytef*>(src);
+    stream.avail_in = (uInt)srcSize;
+    stream.next_out = dest;
+    stream.avail_out = (uInt)destSize;
+
+    int result = inflate(&stream, Z_FINISH);
+    bool ok = result == Z_STREAM_END && stream.total_out == destSize;
+    inflateEnd(&stream);
+    return ok;
+}
+
+}
+
+bool decodeLayerData(const std::string& text,
+                     const std::string& encoding,
+                     const std::string& compression,
+                     std::size_t cellCount,
+                     std::vector<std::uint32_t>& cells){
+    if (encoding != "base64"){
+        LOG_ERROR("Unsupported layer encoding: " << encoding);
+        return false;
+    }
+
+    std::size_t byteCount = cellCount * sizeof(std::uint32_t);
+    cells.assign(cellCount, 0);
+    std::uint8_t* grid = reinterpret_cast<std::uint8_t*>(cells.data());
+
+    if (compression.empty()){
+        // Uncompressed, the base64 decodes directly into the grid unless
+        // the text could be longer than the grid (bad data or line breaks)
+        std::vector<std::uint8_t> spill;
+        std::uint8_t* out = grid;
+        if ((text.size() * 3 + 3) / 4 > byteCount){
+            spill.resize((text.size() * 3 + 3) / 4);
+            out = spill.data();
+        }
+        long written = base64Decode(text, out);
+        if (written != (long)byteCount){
+            LOG_ERROR("Bad base64 layer data");
+            return false;
+        }
+        if (out != grid) std::memcpy(grid, out, byteCount);
+    } else {
+        std::vector<std::uint8_t> packed((text.size() * 3 + 3) / 4);
+        long packedSize = base64Decode(text, packed.data());
+        if (packedSize < 0){
+            LOG_ERROR("Bad base64 layer data");
+            return false;
+        }
+
+        bool ok = false;
+        if (compression == "zlib" || compression == "gzip"){
+            ok = inflateInto(packed.data(), (std::size_t)packedSize, grid, byteCount);
+        } else if (compression == "zstd"){
+#ifdef USE_ZSTD
+            std::size_t result = ZSTD_decompress(grid, byteCount, packed.data(), (std::size_t)packedSize);
+            ok = !ZSTD_isError(result) && result == byteCount;
+#else
+            LOG_ERROR("zstd layer data needs a build with USE_ZSTD=1");
+            return false;
+#endif
+        } else {
+            LOG_ERROR("Unsupported layer compression: " << compression);
+            return false;
+        }
+
+        if (!ok){
+            LOG_ERROR("Failed to decompress " << compression << " layer data");
+            return false;
+        }
+    }
+
+    // Tiled writes gids little endian
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    for (auto& gid : cells){
+        gid = __builtin_bswap32(gid);
+    }
+#endif
+    return true;
+}
@@ -0,0 +1,15 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Decodes Tiled's encoded layer data ("encoding": "base64" with optional
+// "compression": "zlib", "gzip" or "zstd") straight into a grid of gids.
+// cellCount is the number of gids the layer or chunk should hold. Returns
+// false and prints the reason on bad input or an unsupported compression
+bool decodeLayerData(const std::string& text,
+                     const std::string& encoding,
+                     const std::string& compression,
+                     std::size_t cellCount,
+                     std::vector<std::uint32_t>& cells);
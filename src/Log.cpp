@@ -0,0 +1,250 @@
+#include "Log.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace {
+
+// One slot of a ring, a line longer than a slot carries on in the next
+struct Slot {
+    std::uint64_t sequence = 0; // orders lines from different threads
+    LogLevel level = LogLevel::INFO;
+    bool continued = false;     // more of the line in the next slot
+    std::uint16_t length = 0;
+    char text[Log::SLOT_TEXT];
+};
+
+// Single producer (the thread it belongs to), single consumer (the writer)
+struct Ring {
+    Slot slots[Log::RING_SLOTS];
+    std::atomic<std::size_t> head{0}; // next slot the thread writes
+    std::atomic<std::size_t> tail{0}; // next slot the writer reads
+    std::atomic<bool> closed{false};  // thread gone, remove once drained
+};
+
+const std::chrono::milliseconds WRITE_INTERVAL(5);
+
+std::mutex ringsMutex;
+std::vector<std::shared_ptr<Ring>> rings;
+std::atomic<bool> writerRunning{false};
+std::atomic<bool> writerStop{false};
+std::thread writerThread;
+std::atomic<std::uint64_t> nextSequence{0};
+std::atomic<std::uint64_t> dropped{0};
+std::mutex directMutex;
+
+// The calling thread's ring, registered with the writer the first time
+struct ThreadRing {
+    std::shared_ptr<Ring> ring;
+    ~ThreadRing(){
+        if (ring) ring->closed.store(true, std::memory_order_release);
+    }
+};
+
+Ring& threadRing(){
+    thread_local ThreadRing local;
+    if (!local.ring){
+        local.ring = std::make_shared<Ring>();
+        std::lock_guard<std::mutex> lock(ringsMutex);
+        rings.push_back(local.ring);
+    }
+    return *local.ring;
+}
+
+std::FILE* output(LogLevel level){
+    return level >= LogLevel::WARNING ? stderr : stdout;
+}
+
+void writeDirect(LogLevel level, const char* text, std::size_t length){
+    std::lock_guard<std::mutex> lock(directMutex);
+    std::FILE* file = output(level);
+    std::fwrite(text, 1, length, file);
+    std::fputc('\n', file);
+    std::fflush(file);
+}
+
+// A whole line taken off a ring, waiting to be written in sequence order
+struct Pending {
+    std::uint64_t sequence;
+    LogLevel level;
+    std::size_t start;  // into the text buffer
+    std::size_t length;
+};
+
+// Takes every complete line off the rings and writes them out, oldest first.
+// Returns false if there was nothing to write
+bool drainRings(std::vector<Pending>& pending, std::vector<char>& text){
+    pending.clear();
+    text.clear();
+    std::vector<std::pair<Ring*, std::size_t>> consumed;
+
+    {
+        std::lock_guard<std::mutex> lock(ringsMutex);
+        for (const auto& ring : rings){
+            std::size_t tail = ring->tail.load(std::memory_order_relaxed);
+            std::size_t head = ring->head.load(std::memory_order_acquire);
+            for (std::size_t at = tail; at < head;){
+                const Slot& first = ring->slots[at % Log::RING_SLOTS];
+                Pending line{first.sequence, first.level, text.size(), 0};
+                while (true){
+                    const Slot& slot = ring->slots[at % Log::RING_SLOTS];
+                    text.insert(text.end(), slot.text, slot.text + slot.length);
+                    ++at;
+                    if (!slot.continued) break;
+                }
+                line.length = text.size() - line.start;
+                pending.push_back(line);
+            }
+            if (head != tail) consumed.push_back({ring.get(), head});
+        }
+    }
+    if (pending.empty()) return false;
+
+    std::sort(pending.begin(), pending.end(), [](const Pending& a, const Pending& b){
+        return a.sequence < b.sequence;
+    });
+    bool wroteErrors = false;
+    for (const Pending& line : pending){
+        std::FILE* file = output(line.level);
+        std::fwrite(text.data() + line.start, 1, line.length, file);
+        std::fputc('\n', file);
+        wroteErrors |= file == stderr;
+    }
+    std::fflush(stdout);
+    if (wroteErrors) std::fflush(stderr);
+
+    // Only now the slots can be reused, flush() waits on this
+    for (const auto& [ring, head] : consumed){
+        ring->tail.store(head, std::memory_order_release);
+    }
+    return true;
+}
+
+// Drops the rings of threads that are gone and fully written
+void removeClosedRings(){
+    std::lock_guard<std::mutex> lock(ringsMutex);
+    rings.erase(std::remove_if(rings.begin(), rings.end(), [](const std::shared_ptr<Ring>& ring){
+        return ring->closed.load(std::memory_order_acquire) &&
+               ring->tail.load(std::memory_order_relaxed) == ring->head.load(std::memory_order_acquire);
+    }), rings.end());
+}
+
+void runWriter(){
+    std::vector<Pending> pending;
+    std::vector<char> text;
+    std::uint64_t reportedDrops = 0;
+    while (true){
+        bool stopping = writerStop.load(std::memory_order_acquire);
+        drainRings(pending, text);
+        removeClosedRings();
+
+        std::uint64_t drops = dropped.load(std::memory_order_relaxed);
+        if (drops != reportedDrops){
+            std::fprintf(stderr, "%llu log lines dropped, the log is falling behind\n",
+                         (unsigned long long)(drops - reportedDrops));
+            reportedDrops = drops;
+        }
+        if (stopping) return;
+        std::this_thread::sleep_for(WRITE_INTERVAL);
+    }
+}
+
+} // namespace
+
+void Log::submit(LogLevel level, const char* text, std::size_t length){
+    if (!writerRunning.load(std::memory_order_acquire)){
+        writeDirect(level, text, length);
+        return;
+    }
+
+    Ring& ring = threadRing();
+    std::size_t needed = std::max<std::size_t>(1, (length + SLOT_TEXT - 1) / SLOT_TEXT);
+    std::size_t head = ring.head.load(std::memory_order_relaxed);
+    while (head + needed - ring.tail.load(std::memory_order_acquire) > RING_SLOTS){
+        if (level < LogLevel::WARNING){
+            dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        if (!writerRunning.load(std::memory_order_acquire)){
+            writeDirect(level, text, length);
+            return;
+        }
+        std::this_thread::yield();
+    }
+
+    std::uint64_t sequence = nextSequence.fetch_add(1, std::memory_order_relaxed);
+    for (std::size_t i = 0; i < needed; ++i){
+        Slot& slot = ring.slots[(head + i) % RING_SLOTS];
+        std::size_t part = std::min(length - std::min(length, i * SLOT_TEXT), SLOT_TEXT);
+        slot.sequence = sequence;
+        slot.level = level;
+        slot.continued = i + 1 < needed;
+        slot.length = (std::uint16_t)part;
+        std::memcpy(slot.text, text + i * SLOT_TEXT, part);
+    }
+    ring.head.store(head + needed, std::memory_order_release);
+}
+
+void Log::flush(){
+    if (!writerRunning.load(std::memory_order_acquire)) return;
+
+    std::vector<std::pair<std::shared_ptr<Ring>, std::size_t>> waiting;
+    {
+        std::lock_guard<std::mutex> lock(ringsMutex);
+        for (const auto& ring : rings){
+            waiting.push_back({ring, ring->head.load(std::memory_order_acquire)});
+        }
+    }
+    for (const auto& [ring, head] : waiting){
+        while (ring->tail.load(std::memory_order_acquire) < head && writerRunning.load(std::memory_order_acquire)){
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+}
+
+std::uint64_t Log::getDropped(){
+    return dropped.load(std::memory_order_relaxed);
+}
+
+LogLine::LogLine(LogLevel level) : _level(level), _stream(stream()){
+    buffer().reset();
+    _stream.clear();
+}
+
+LogLine::~LogLine(){
+    Log::submit(_level, buffer().data(), buffer().size());
+}
+
+LogLine::Buffer& LogLine::buffer(){
+    thread_local Buffer local;
+    return local;
+}
+
+std::ostream& LogLine::stream(){
+    thread_local std::ostream local(&buffer());
+    return local;
+}
+
+LogWriter::LogWriter(){
+    writerStop.store(false, std::memory_order_relaxed);
+    writerThread = std::thread(runWriter);
+    writerRunning.store(true, std::memory_order_release);
+}
+
+LogWriter::~LogWriter(){
+    // Lines logged from here on go straight out, the writer empties the
+    // rings one last time before it stops
+    writerRunning.store(false, std::memory_order_release);
+    writerStop.store(true, std::memory_order_release);
+    writerThread.join();
+
+    // and anything a thread got in just as it stopped
+    std::vector<Pending> pending;
+    std::vector<char> text;
+    drainRings(pending, text);
+}
@@ -0,0 +1,108 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <streambuf>
+
+// Debug and info go to stdout, warnings and errors to stderr
+enum class LogLevel { DEBUG, INFO, WARNING, ERROR };
+
+// Log sites below this level are compiled out (make LOG_LEVEL=2 keeps only
+// warnings and errors). The rest are filtered at run time by Log::setLevel
+#ifndef LOG_MIN_LEVEL
+#define LOG_MIN_LEVEL 0
+#endif
+
+// Logs one line, message being anything that can go to a std::ostream
+// joined with <<, e.g. LOG_INFO("Loaded " << count << " tiles"). The message
+// isn't evaluated unless the level is on. Don't log from inside a message
+#define LOG_AT(level, message) \
+    do { \
+        if constexpr ((int)(level) >= LOG_MIN_LEVEL){ \
+            if (Log::isEnabled(level)) LogLine(level) << message; \
+        } \
+    } while (false)
+
+#define LOG_DEBUG(message) LOG_AT(LogLevel::DEBUG, message)
+#define LOG_INFO(message) LOG_AT(LogLevel::INFO, message)
+#define LOG_WARNING(message) LOG_AT(LogLevel::WARNING, message)
+#define LOG_ERROR(message) LOG_AT(LogLevel::ERROR, message)
+
+// Lines are formatted on the thread logging them into its own ring buffer
+// and written out in batches by the LogWriter's thread, so a slow console
+// never holds up a load or a frame. Without a LogWriter running, lines are
+// written straight away
+class Log {
+public:
+    // Lines each logging thread can have waiting, and the characters of
+    // a line that fit one slot (longer lines take several)
+    static constexpr std::size_t RING_SLOTS = 512;
+    static constexpr std::size_t SLOT_TEXT = 240;
+    // Longest line, anything past it is cut off
+    static constexpr std::size_t MAX_LINE = 1024;
+
+    static void setLevel(LogLevel level) { _level.store((int)level, std::memory_order_relaxed); }
+    static bool isEnabled(LogLevel level) { return (int)level >= _level.load(std::memory_order_relaxed); }
+
+    // Waits until every line logged so far is written out
+    static void flush();
+
+    // Debug and info lines thrown away because a ring was full. Warnings
+    // and errors wait for room instead
+    static std::uint64_t getDropped();
+
+private:
+    friend class LogLine;
+    friend class LogWriter;
+
+    static inline std::atomic<int> _level{(int)LogLevel::INFO};
+
+    static void submit(LogLevel level, const char* text, std::size_t length);
+};
+
+// One line being logged, it goes out when this is destroyed. LOG_AT makes
+// these, use one directly for a line built in several steps
+class LogLine {
+public:
+    explicit LogLine(LogLevel level);
+    ~LogLine();
+
+    LogLine(const LogLine&) = delete;
+    LogLine& operator=(const LogLine&) = delete;
+
+    template <typename T>
+    LogLine& operator<<(const T& value){
+        _stream << value;
+        return *this;
+    }
+
+private:
+    // Fixed buffer for the line being formatted, so logging doesn't allocate
+    class Buffer : public std::streambuf {
+    public:
+        Buffer() { reset(); }
+        void reset() { setp(_text, _text + sizeof(_text)); }
+        const char* data() const { return pbase(); }
+        std::size_t size() const { return (std::size_t)(pptr() - pbase()); }
+    private:
+        char _text[Log::MAX_LINE];
+    };
+
+    LogLevel _level;
+    std::ostream& _stream;
+
+    static Buffer& buffer();
+    static std::ostream& stream();
+};
+
+// Runs the thread writing the rings out while it lives. Lines still waiting
+// are written before it goes. One at a time, made early in main
+class LogWriter {
+public:
+    LogWriter();
+    ~LogWriter();
+
+    LogWriter(const LogWriter&) = delete;
+    LogWriter& operator=(const LogWriter&) = delete;
+};
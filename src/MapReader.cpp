@@ -0,0 +1,272 @@
+#include "MapReader.hpp"
+#include "Log.hpp"
+#include "LayerDecoder.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+#include "../libs/json.hpp"
+
+using json = nlohmann::json;
+
+namespace {
+
+// Where in the document the parser currently is
+enum class Scope {
+    Root,
+    Tilesets,
+    Tileset,
+    Layers,
+    Layer,
+    Chunks,
+    Chunk,
+    Data,
+    Objects,
+    Object,
+    Properties,
+    Property,
+    Skip // anything we don't read, including all of its children
+};
+
+class MapSaxHandler {
+public:
+    explicit MapSaxHandler(MapFile& map) : _map(map) {}
+
+    bool null(){ return true; }
+    bool boolean(bool value){
+        if (scope() == Scope::Root && _key == "infinite") _map.infinite = value;
+        else if (scope() == Scope::Object && _key == "point") object().point = value;
+        else if (scope() == Scope::Layer && _key == "repeatx") _map.layers.back().repeatX = value;
+        else if (scope() == Scope::Layer && _key == "repeaty") _map.layers.back().repeatY = value;
+        else if (scope() == Scope::Property && _key == "value") _properties->back().number = value ? 1.0 : 0.0;
+        return true;
+    }
+    bool number_integer(json::number_integer_t value){
+        if (scope() == Scope::Data){
+            _data->push_back((std::uint32_t)value);
+            return true;
+        }
+        return number((double)value);
+    }
+    bool number_unsigned(json::number_unsigned_t value){
+        if (scope() == Scope::Data){
+            // the hot path, every cell of every layer comes through here
+            _data->push_back((std::uint32_t)value);
+            return true;
+        }
+        return number((double)value);
+    }
+    bool number_float(json::number_float_t value, const json::string_t&){ return number(value); }
+    bool string(json::string_t& value){
+        switch (scope()){
+            case Scope::Tileset:
+                if (_key == "source") _map.tilesets.back().source = value;
+                break;
+            case Scope::Layer: {
+                MapLayerSource& layer = _map.layers.back();
+                if (_key == "name") layer.name = value;
+                else if (_key == "type") layer.type = value;
+                else if (_key == "encoding") layer.encoding = value;
+                else if (_key == "compression") layer.compression = value;
+                else if (_key == "image") layer.image = value;
+                else if (_key == "data") layer.encodedData = std::move(value);
+                break;
+            }
+            case Scope::Chunk:
+                if (_key == "data") _map.layers.back().chunks.back().encodedData = std::move(value);
+                break;
+            case Scope::Object:
+                if (_key == "name") object().name = value;
+                else if (_key == "type" || _key == "class") object().type = value;
+                break;
+            case Scope::Property:
+                if (_key == "name") _properties->back().name = value;
+                else if (_key == "value") _properties->back().text = value;
+                break;
+            default:
+                break;
+        }
+        return true;
+    }
+    bool binary(json::binary_t&){ return true; }
+
+    bool start_object(std::size_t){
+        Scope current = scope();
+        if (current == Scope::Tilesets){
+            _map.tilesets.emplace_back();
+            _scopes.push_back(Scope::Tileset);
+        } else if (current == Scope::Layers){
+            _map.layers.emplace_back();
+            _scopes.push_back(Scope::Layer);
+        } else if (current == Scope::Chunks){
+            _map.layers.back().chunks.emplace_back();
+            _scopes.push_back(Scope::Chunk);
+        } else if (current == Scope::Objects){
+            _map.layers.back().objects.emplace_back();
+            _scopes.push_back(Scope::Object);
+        } else if (current == Scope::Properties){
+            _properties->emplace_back();
+            _scopes.push_back(Scope::Property);
+        } else if (_scopes.empty()){
+            _scopes.push_back(Scope::Root);
+        } else {
+            _scopes.push_back(Scope::Skip);
+        }
+        return true;
+    }
+    bool end_object(){ _scopes.pop_back(); return true; }
+
+    bool key(json::string_t& name){
+        _key = name;
+        return true;
+    }
+
+    bool start_array(std::size_t){
+        Scope current = scope();
+        if (current == Scope::Root && _key == "tilesets") _scopes.push_back(Scope::Tilesets);
+        else if (current == Scope::Root && _key == "layers") _scopes.push_back(Scope::Layers);
+        else if (current == Scope::Layer && _key == "chunks") _scopes.push_back(Scope::Chunks);
+        else if (current == Scope::Layer && _key == "objects") _scopes.push_back(Scope::Objects);
+        else if (current == Scope::Object && _key == "properties"){
+            _properties = &object().properties;
+            _scopes.push_back(Scope::Properties);
+        } else if (current == Scope::Layer && _key == "properties"){
+            _properties = &_map.layers.back().properties;
+            _scopes.push_back(Scope::Properties);
+        }
+        else if (current == Scope::Layer && _key == "data"){
+            _data = &_map.layers.back().data;
+            _scopes.push_back(Scope::Data);
+        } else if (current == Scope::Chunk && _key == "data"){
+            _data = &_map.layers.back().chunks.back().data;
+            _scopes.push_back(Scope::Data);
+        } else {
+            _scopes.push_back(Scope::Skip);
+        }
+        return true;
+    }
+    bool end_array(){
+        if (scope() == Scope::Data) _data = nullptr;
+        _scopes.pop_back();
+        return true;
+    }
+
+    bool parse_error(std::size_t, const std::string&, const nlohmann::detail::exception& e){
+        LOG_ERROR("JSON parse error: " << e.what());
+        return false;
+    }
+
+private:
+    MapFile& _map;
+    std::vector<Scope> _scopes;
+    std::string _key;
+    std::vector<std::uint32_t>* _data = nullptr; // grid being filled, if any
+    std::vector<MapProperty>* _properties = nullptr; // object or layer being filled
+
+    Scope scope() const { return _scopes.empty() ? Scope::Skip : _scopes.back(); }
+    MapObjectSource& object() { return _map.layers.back().objects.back(); }
+
+    bool number(double value){
+        switch (scope()){
+            case Scope::Root:
+                if (_key == "width") _map.width = (int)value;
+                else if (_key == "height") _map.height = (int)value;
+                else if (_key == "tilewidth") _map.tileWidth = (int)value;
+                else if (_key == "tileheight") _map.tileHeight = (int)value;
+                else if (_key == "infinite") _map.infinite = value != 0;
+                break;
+            case Scope::Tileset:
+                if (_key == "firstgid") _map.tilesets.back().firstGid = (int)value;
+                break;
+            case Scope::Layer: {
+                MapLayerSource& layer = _map.layers.back();
+                if (_key == "id") layer.id = (int)value;
+                else if (_key == "width") layer.width = (int)value;
+                else if (_key == "height") layer.height = (int)value;
+                else if (_key == "offsetx") layer.offsetX = (float)value;
+                else if (_key == "offsety") layer.offsetY = (float)value;
+                else if (_key == "parallaxx") layer.parallaxX = (float)value;
+                else if (_key == "parallaxy") layer.parallaxY = (float)value;
+                else if (_key == "opacity") layer.opacity = (float)value;
+                break;
+            }
+            case Scope::Chunk: {
+                MapChunkSource& chunk = _map.layers.back().chunks.back();
+                if (_key == "x") chunk.x = (int)value;
+                else if (_key == "y") chunk.y = (int)value;
+                else if (_key == "width") chunk.width = (int)value;
+                else if (_key == "height") chunk.height = (int)value;
+                break;
+            }
+            case Scope::Object: {
+                MapObjectSource& obj = object();
+                if (_key == "id") obj.id = (int)value;
+                else if (_key == "x") obj.x = (float)value;
+                else if (_key == "y") obj.y = (float)value;
+                else if (_key == "width") obj.width = (float)value;
+                else if (_key == "height") obj.height = (float)value;
+                else if (_key == "gid") obj.gid = (std::uint32_t)value;
+                break;
+            }
+            case Scope::Property:
+                if (_key == "value") _properties->back().number = value;
+                break;
+            default:
+                break;
+        }
+        return true;
+    }
+};
+
+}
+
+bool readMapFile(const std::string& filePath, MapFile& map){
+    std::ifstream file(filePath, std::ios::binary);
+    if (!file.is_open()){
+        LOG_ERROR("Failed to open map file: " << filePath);
+        return false;
+    }
+
+    // Parsing from memory is a lot quicker than going through the stream
+    // a character at a time
+    std::string text((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+    MapSaxHandler handler(map);
+    if (!json::sax_parse(text, &handler)){
+        return false;
+    }
+
+    // Key order puts "encoding" after "data", so base64 layers can only be
+    // decoded now
+    for (auto& layer : map.layers){
+        if (!layer.encodedData.empty()){
+            std::size_t cellCount = (std::size_t)layer.width * layer.height;
+            if (!decodeLayerData(layer.encodedData, layer.encoding, layer.compression, cellCount, layer.data)){
+                LOG_ERROR("Failed to decode layer " << layer.name << " in " << filePath);
+                return false;
+            }
+            std::string().swap(layer.encodedData);
+        }
+        for (auto& chunk : layer.chunks){
+            if (chunk.encodedData.empty() || chunk.width <= 0 || chunk.height <= 0) continue;
+            std::size_t cellCount = (std::size_t)chunk.width * chunk.height;
+            if (!decodeLayerData(chunk.encodedData, layer.encoding, layer.compression, cellCount, chunk.data)){
+                LOG_ERROR("Failed to decode a chunk of layer " << layer.name << " in " << filePath);
+                return false;
+            }
+            std::string().swap(chunk.encodedData);
+        }
+
+        // A chunk whose cells don't fill its width x height would divide by
+        // zero or write past the layer when the grid is built, leave it out
+        layer.chunks.erase(std::remove_if(layer.chunks.begin(), layer.chunks.end(), [&](const MapChunkSource& chunk){
+            if (chunk.width > 0 && chunk.height > 0 && chunk.data.size() == (std::size_t)chunk.width * chunk.height){
+                return false;
+            }
+            LOG_WARNING("Skipping a " << chunk.width << "x" << chunk.height << " chunk with " << chunk.data.size()
+                        << " cells at (" << chunk.x << ", " << chunk.y << ") in layer " << layer.name << " of " << filePath);
+            return true;
+        }), layer.chunks.end());
+    }
+    return true;
+}
@@ -0,0 +1,86 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Raw contents of a Tiled map file as they come off the parser, before the
+// TileMap turns them into its grid. Tile data lands directly in typed
+// vectors, there is no JSON document in between
+
+// One chunk of an infinite map layer
+struct MapChunkSource {
+    int x = 0;
+    int y = 0;
+    int width = 0;
+    int height = 0;
+    std::vector<std::uint32_t> data;
+    std::string encodedData; // base64 text until it is decoded into data
+};
+
+// A custom property on a map object or layer, numbers and bools land in number
+struct MapProperty {
+    std::string name;
+    std::string text;
+    double number = 0.0;
+};
+
+// An object from an object layer, in Tiled's pixel coordinates
+struct MapObjectSource {
+    int id = 0;
+    std::string name;
+    std::string type; // the object's class
+    float x = 0.f;
+    float y = 0.f;
+    float width = 0.f;
+    float height = 0.f;
+    bool point = false;
+    std::uint32_t gid = 0; // tile objects, their y is the bottom edge
+    std::vector<MapProperty> properties;
+};
+
+struct MapLayerSource {
+    std::string name;
+    std::string type = "tilelayer";
+    int id = 0;
+    int width = 0;
+    int height = 0;
+    std::vector<std::uint32_t> data;     // finite maps, row major
+    std::vector<MapChunkSource> chunks;  // infinite maps
+    std::string encoding;                // "csv" (plain array) or "base64"
+    std::string compression;             // "", "zlib", "gzip" or "zstd"
+    std::string encodedData;
+    std::vector<MapObjectSource> objects; // object layers
+
+    // image layers, Tiled also allows offsets and parallax on the other
+    // layer types but we only use them here
+    std::string image;
+    float offsetX = 0.f;
+    float offsetY = 0.f;
+    float parallaxX = 1.f;
+    float parallaxY = 1.f;
+    bool repeatX = false;
+    bool repeatY = false;
+    float opacity = 1.f;
+
+    std::vector<MapProperty> properties;
+};
+
+struct MapTilesetRef {
+    int firstGid = 0;
+    std::string source;
+};
+
+struct MapFile {
+    int width = 0;
+    int height = 0;
+    int tileWidth = 0;
+    int tileHeight = 0;
+    bool infinite = false;
+    std::vector<MapTilesetRef> tilesets;
+    std::vector<MapLayerSource> layers;
+};
+
+// Streams a Tiled .json map through nlohmann's SAX interface. Base64 layer
+// data is decoded once the layer's encoding is known. Returns false and
+// prints the reason if the file can't be opened, parsed or decoded
+bool readMapFile(const std::string& filePath, MapFile& map);
@@ -0,0 +1,76 @@
+#include "ParallaxBackground.hpp"
+#include <cmath>
+
+void ParallaxBackground::addLayer(ParallaxLayer layer){
+    if (!layer.texture || layer.scale <= 0.f) return;
+    if (layer.repeatX || layer.repeatY) layer.texture->setRepeated(true);
+    _layers.push_back(std::move(layer));
+}
+
+// The span of one axis a layer covers on screen, and the texture coordinate
+// at its start. Repeating layers fill the whole view, the others just
+// cover their image
+static void layerSpan(float viewStart, float viewSize, float origin, float imageSize, float scale, bool repeat,
+                      float& start, float& end, float& texStart){
+    if (repeat){
+        start = viewStart;
+        end = viewStart + viewSize;
+        // whole images between the origin and the view don't change the
+        // picture, dropping them keeps the texture coordinates small
+        float skipped = std::floor((start - origin) / imageSize) * imageSize;
+        texStart = (start - origin - skipped) / scale;
+    }
+    else {
+        start = origin;
+        end = origin + imageSize;
+        texStart = 0.f;
+    }
+}
+
+void ParallaxBackground::draw(sf::RenderTarget& target) const{
+    const sf::View& view = target.getView();
+    sf::Vector2f viewSize = view.getSize();
+    sf::Vector2f viewTopLeft = view.getCenter() - viewSize / 2.f;
+
+    for (const auto& layer : _layers){
+        // Tiled shifts a layer by (1 - parallax) of the camera's movement
+        sf::Vector2f origin = {
+            layer.offset.x + view.getCenter().x * (1.f - layer.parallax.x),
+            layer.offset.y + view.getCenter().y * (1.f - layer.parallax.y)
+        };
+        sf::Vector2f imageSize = sf::Vector2f(layer.texture->getSize()) * layer.scale;
+
+        float left, right, texLeft;
+        float top, bottom, texTop;
+        layerSpan(viewTopLeft.x, viewSize.x, origin.x, imageSize.x, layer.scale, layer.repeatX, left, right, texLeft);
+        layerSpan(viewTopLeft.y, viewSize.y, origin.y, imageSize.y, layer.scale, layer.repeatY, top, bottom, texTop);
+
+        // off screen
+        if (right <= viewTopLeft.x || left >= viewTopLeft.x + viewSize.x ||
+            bottom <= viewTopLeft.y || top >= viewTopLeft.y + viewSize.y) continue;
+
+        float texRight = texLeft + (right - left) / layer.scale;
+        float texBottom = texTop + (bottom - top) / layer.scale;
+
+        sf::Vertex quad[6];
+        quad[0].position = {left, top};
+        quad[1].position = {right, top};
+        quad[2].position = {left, bottom};
+        quad[3].position = {left, bottom};
+        quad[4].position = {right, top};
+        quad[5].position = {right, bottom};
+
+        quad[0].texCoords = {texLeft, texTop};
+        quad[1].texCoords = {texRight, texTop};
+        quad[2].texCoords = {texLeft, texBottom};
+        quad[3].texCoords = {texLeft, texBottom};
+        quad[4].texCoords = {texRight, texTop};
+        quad[5].texCoords = {texRight, texBottom};
+
+        for (auto& vertex : quad) vertex.color = layer.tint;
+
+        sf::RenderStates states;
+        states.texture = layer.texture.get();
+        target.draw(quad, 6, sf::PrimitiveType::Triangles, states);
+    }
+}
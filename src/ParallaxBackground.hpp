@@ -0,0 +1,35 @@
+#pragma once
+#include <SFML/Graphics.hpp>
+#include <memory>
+#include <vector>
+
+// One image scrolling behind the map
+struct ParallaxLayer {
+    std::shared_ptr<sf::Texture> texture;
+    sf::Vector2f offset;              // world position of the image at parallax 1
+    sf::Vector2f parallax = {1.f, 1.f}; // 1 moves with the map, 0 stays on screen
+    float scale = 1.f;
+    bool repeatX = false;
+    bool repeatY = false;
+    sf::Color tint = sf::Color::White;
+};
+
+// Background images drawn back to front, each as a single quad over the
+// view with the texture set to repeat, so a layer costs one draw call no
+// matter how wide the map is. Layers follow Tiled's image layer rules
+class ParallaxBackground {
+public:
+    ParallaxBackground() = default;
+
+    void addLayer(ParallaxLayer layer);
+    void clear() { _layers.clear(); }
+    bool empty() const { return _layers.empty(); }
+
+    const std::vector<ParallaxLayer>& getLayers() const { return _layers; }
+
+    // Draws every layer for the target's current view
+    void draw(sf::RenderTarget& target) const;
+
+private:
+    std::vector<ParallaxLayer> _layers;
+};
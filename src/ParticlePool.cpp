@@ -0,0 +1,137 @@
+#include "ParticlePool.hpp"
+#include "AabbBatch.hpp"
+#include <algorithm>
+#include <cmath>
+
+ParticlePool::ParticlePool(std::size_t capacity, const sf::Texture* texture, sf::IntRect textureRect)
+    : _texture(texture), _textureRect(textureRect), _vertices(sf::PrimitiveType::Triangles, capacity * 6){
+    _posX.resize(capacity);
+    _posY.resize(capacity);
+    _velX.resize(capacity);
+    _velY.resize(capacity);
+    _age.resize(capacity);
+    _lifetime.resize(capacity);
+    _size.resize(capacity);
+    _color.resize(capacity);
+    _visible.resize(capacity);
+
+    // whole texture unless told otherwise
+    if (_texture && _textureRect.size.x == 0 && _textureRect.size.y == 0){
+        _textureRect = sf::IntRect({0, 0}, sf::Vector2i(_texture->getSize()));
+    }
+}
+
+float ParticlePool::random(float min, float max){
+    _seed ^= _seed << 13;
+    _seed ^= _seed >> 17;
+    _seed ^= _seed << 5;
+    return min + (max - min) * (_seed >> 8) * (1.f / 16777216.f);
+}
+
+void ParticlePool::emit(const ParticleEmitter& emitter, const sf::Vector2f& position, int count){
+    const float degToRad = 3.14159265f / 180.f;
+    _largest = std::max({_largest, emitter.sizeMin, emitter.sizeMax});
+
+    for (int n = 0; n < count && _count < capacity(); ++n){
+        std::size_t i = _count++;
+        float angle = random(emitter.angleMin, emitter.angleMax) * degToRad;
+        float speed = random(emitter.speedMin, emitter.speedMax);
+
+        _posX[i] = position.x + random(-0.5f, 0.5f) * emitter.area.x;
+        _posY[i] = position.y + random(-0.5f, 0.5f) * emitter.area.y;
+        _velX[i] = std::cos(angle) * speed;
+        _velY[i] = std::sin(angle) * speed;
+        _age[i] = 0.f;
+        _lifetime[i] = std::max(random(emitter.lifetimeMin, emitter.lifetimeMax), 0.001f);
+        _size[i] = random(emitter.sizeMin, emitter.sizeMax);
+        _color[i] = emitter.color;
+    }
+}
+
+void ParticlePool::update(float dt, const sf::FloatRect& view){
+    // integrate, plain loops over flat arrays so they vectorise
+    float damping = std::max(0.f, 1.f - _drag * dt);
+    float accelX = _acceleration.x * dt;
+    float accelY = _acceleration.y * dt;
+    for (std::size_t i = 0; i < _count; ++i){
+        _velX[i] = (_velX[i] + accelX) * damping;
+        _velY[i] = (_velY[i] + accelY) * damping;
+    }
+    for (std::size_t i = 0; i < _count; ++i){
+        _posX[i] += _velX[i] * dt;
+        _posY[i] += _velY[i] * dt;
+        _age[i] += dt;
+    }
+
+    // drop dead particles by moving the last one into their place
+    std::size_t i = 0;
+    while (i < _count){
+        if (_age[i] < _lifetime[i]){
+            ++i;
+            continue;
+        }
+        std::size_t last = --_count;
+        _posX[i] = _posX[last];
+        _posY[i] = _posY[last];
+        _velX[i] = _velX[last];
+        _velY[i] = _velY[last];
+        _age[i] = _age[last];
+        _lifetime[i] = _lifetime[last];
+        _size[i] = _size[last];
+        _color[i] = _color[last];
+    }
+
+    // Only the particles in view get vertices. The batch box test takes boxes
+    // by their top left corner and particles are centred on their position,
+    // so the view grows right and down by half the biggest particle instead.
+    // That keeps a few just past those edges, never drops a visible one
+    sf::FloatRect cullBox(view.position, view.size + sf::Vector2f(_largest, _largest) * 0.5f);
+    _drawn = overlapBatch(cullBox, _posX.data(), _posY.data(), _size.data(), _size.data(), _count, _visible.data());
+
+    // two triangles per particle
+    float texLeft = (float)_textureRect.position.x;
+    float texTop = (float)_textureRect.position.y;
+    float texRight = texLeft + _textureRect.size.x;
+    float texBottom = texTop + _textureRect.size.y;
+
+    for (std::size_t n = 0; n < _drawn; ++n){
+        std::size_t p = _visible[n];
+        float half = _size[p] * 0.5f;
+        float left = _posX[p] - half;
+        float top = _posY[p] - half;
+        float right = _posX[p] + half;
+        float bottom = _posY[p] + half;
+
+        sf::Color color = _color[p];
+        color.a = static_cast<std::uint8_t>(color.a * (1.f - _age[p] / _lifetime[p]));
+
+        sf::Vertex* quad = &_vertices[n * 6];
+        quad[0].position = {left, top};
+        quad[1].position = {right, top};
+        quad[2].position = {left, bottom};
+        quad[3].position = {left, bottom};
+        quad[4].position = {right, top};
+        quad[5].position = {right, bottom};
+
+        quad[0].texCoords = {texLeft, texTop};
+        quad[1].texCoords = {texRight, texTop};
+        quad[2].texCoords = {texLeft, texBottom};
+        quad[3].texCoords = {texLeft, texBottom};
+        quad[4].texCoords = {texRight, texTop};
+        quad[5].texCoords = {texRight, texBottom};
+
+        for (int v = 0; v < 6; ++v) quad[v].color = color;
+    }
+}
+
+void ParticlePool::draw(sf::RenderTarget& target) const{
+    if (_drawn == 0) return;
+    sf::RenderStates states;
+    states.texture = _texture;
+    target.draw(&_vertices[0], _drawn * 6, sf::PrimitiveType::Triangles, states);
+}
+
+void ParticlePool::clear(){
+    _count = 0;
+    _drawn = 0;
+}
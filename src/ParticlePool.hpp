@@ -0,0 +1,76 @@
+#pragma once
+#include <SFML/Graphics.hpp>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+// How particles start out, every value is picked at random between its
+// min and max for each particle
+struct ParticleEmitter {
+    sf::Vector2f area;          // spawn anywhere in this box, centred on the position
+    float angleMin = 0.f;       // direction in degrees, 0 is right and 90 is down
+    float angleMax = 360.f;
+    float speedMin = 0.f;
+    float speedMax = 0.f;
+    float lifetimeMin = 1.f;    // seconds
+    float lifetimeMax = 1.f;
+    float sizeMin = 2.f;        // width and height in pixels
+    float sizeMax = 2.f;
+    sf::Color color = sf::Color::White;
+};
+
+// A fixed number of particles sharing one texture (or none, for plain
+// coloured squares) and one set of forces. Particles are stored as one
+// array per field and packed at the front, so the update is a straight
+// loop the compiler can vectorise, and the whole pool is one draw call.
+// Emitting into a full pool drops the new particles
+class ParticlePool {
+public:
+    // texture may be null, textureRect picks the part of it every particle shows
+    explicit ParticlePool(std::size_t capacity, const sf::Texture* texture = nullptr, sf::IntRect textureRect = {});
+
+    // Constant acceleration, e.g. gravity or wind
+    void setAcceleration(const sf::Vector2f& acceleration) { _acceleration = acceleration; }
+    // Fraction of velocity lost per second
+    void setDrag(float drag) { _drag = drag; }
+
+    // Spawns count particles around position
+    void emit(const ParticleEmitter& emitter, const sf::Vector2f& position, int count);
+
+    // Moves and ages every particle, drops the dead ones and rebuilds the
+    // vertices of the ones inside view, which are all draw shows. Particles
+    // fade out over their lifetime
+    void update(float dt, const sf::FloatRect& view);
+
+    void draw(sf::RenderTarget& target) const;
+
+    void clear();
+
+    std::size_t size() const { return _count; }
+    std::size_t capacity() const { return _posX.size(); }
+
+private:
+    std::size_t _count = 0;
+    std::vector<float> _posX;
+    std::vector<float> _posY;
+    std::vector<float> _velX;
+    std::vector<float> _velY;
+    std::vector<float> _age;
+    std::vector<float> _lifetime;
+    std::vector<float> _size;
+    std::vector<sf::Color> _color;
+
+    sf::Vector2f _acceleration;
+    float _drag = 0.f;
+
+    const sf::Texture* _texture = nullptr;
+    sf::IntRect _textureRect;
+    sf::VertexArray _vertices;
+    std::size_t _drawn = 0;              // particles with vertices, the ones in view
+    std::vector<std::uint32_t> _visible; // batch box test hits, sized to capacity
+    float _largest = 0.f;                // biggest size emitted so far
+
+    // xorshift, plenty for effects and much cheaper than <random>
+    std::uint32_t _seed = 0x9E3779B9u;
+    float random(float min, float max);
+};
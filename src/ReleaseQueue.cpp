@@ -0,0 +1,20 @@
+#include "ReleaseQueue.hpp"
+
+// Pops resources off the front until the budget runs out
+std::size_t ReleaseQueue::drain(sf::Time budget){
+    std::size_t released = 0;
+    sf::Clock timer;
+    while (!_pending.empty()){
+        _pending.pop_front();
+        ++released;
+        if (timer.getElapsedTime() >= budget) break;
+    }
+    return released;
+}
+
+// Frees everything that is still queued
+std::size_t ReleaseQueue::drainAll(){
+    std::size_t released = _pending.size();
+    _pending.clear();
+    return released;
+}
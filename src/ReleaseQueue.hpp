@@ -0,0 +1,41 @@
+#pragma once
+#include <SFML/System.hpp>
+#include <deque>
+#include <memory>
+#include <cstddef>
+
+// Deferred destruction of GPU backed resources (textures, vertex buffers,
+// render textures). Owners hand their handles over instead of dropping them,
+// and the queue frees a few per frame so a level teardown never turns into
+// one long burst of glDelete* calls in the middle of a frame
+class ReleaseQueue {
+public:
+    ReleaseQueue() = default;
+    ReleaseQueue(const ReleaseQueue&) = delete;
+    ReleaseQueue& operator=(const ReleaseQueue&) = delete;
+
+    // takes shared ownership of a resource, it is freed once drained
+    // (or later, if something else still holds a reference)
+    template <typename T>
+    void defer(std::shared_ptr<T> resource){
+        if (resource) _pending.push_back(std::move(resource));
+    }
+
+    template <typename T>
+    void defer(std::unique_ptr<T> resource){
+        if (resource) _pending.push_back(std::shared_ptr<T>(std::move(resource)));
+    }
+
+    // releases resources until the time budget is spent, always at least one
+    // so the queue keeps moving even with a tiny budget
+    std::size_t drain(sf::Time budget);
+
+    // releases everything, used on loading screens and menus
+    std::size_t drainAll();
+
+    std::size_t size() const { return _pending.size(); }
+    bool empty() const { return _pending.empty(); }
+
+private:
+    std::deque<std::shared_ptr<void>> _pending;
+};
@@ -0,0 +1,237 @@
+#include "ResourceMemory.hpp"
+#include "Log.hpp"
+#include <algorithm>
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+
+std::mutex registryMutex;
+std::unordered_map<std::uint64_t, ResourceInfo> resources;
+std::uint64_t nextId = 1;
+std::size_t total = 0;
+std::size_t peak = 0;
+std::size_t budget = ResourceMemory::DEFAULT_BUDGET;
+std::atomic<std::uint64_t> revision{0};
+
+// Deleter of the textures from makeTexture, the record goes with the texture
+struct TextureMemory {
+    MemoryRecord record;
+    void operator()(sf::Texture* texture) const { delete texture; }
+};
+
+float megabytes(std::size_t bytes){
+    return bytes / (1024.f * 1024.f);
+}
+
+const char* kindName(ResourceKind kind){
+    switch (kind){
+        case ResourceKind::TEXTURE: return "texture";
+        case ResourceKind::IMAGE: return "image";
+        case ResourceKind::VERTICES: return "vertices";
+        case ResourceKind::DATA: return "data";
+    }
+    return "?";
+}
+
+std::string groupName(const std::string& group){
+    return group.empty() ? "shared" : group;
+}
+
+// Bytes and resource count of one group, owner and kind
+struct Total {
+    std::size_t count = 0;
+    std::size_t bytes = 0;
+};
+using TotalKey = std::tuple<std::string, std::string, ResourceKind>;
+
+// Call with the registry locked
+std::map<TotalKey, Total> totalsLocked(){
+    std::map<TotalKey, Total> totals;
+    for (const auto& [id, info] : resources){
+        Total& entry = totals[{info.group, info.owner, info.kind}];
+        ++entry.count;
+        entry.bytes += info.bytes;
+    }
+    return totals;
+}
+
+} // namespace
+
+MemoryRecord::MemoryRecord(ResourceInfo info){
+    std::lock_guard<std::mutex> lock(registryMutex);
+    _id = nextId++;
+    total += info.bytes;
+    peak = std::max(peak, total);
+    resources.emplace(_id, std::move(info));
+    ++revision;
+}
+
+MemoryRecord::~MemoryRecord(){
+    if (_id == 0) return;
+    std::lock_guard<std::mutex> lock(registryMutex);
+    auto it = resources.find(_id);
+    total -= it->second.bytes;
+    resources.erase(it);
+    ++revision;
+}
+
+MemoryRecord::MemoryRecord(MemoryRecord&& other) noexcept : _id(other._id){
+    other._id = 0;
+}
+
+MemoryRecord& MemoryRecord::operator=(MemoryRecord&& other) noexcept{
+    if (this != &other){
+        MemoryRecord old(std::move(*this));
+        _id = other._id;
+        other._id = 0;
+    }
+    return *this;
+}
+
+void MemoryRecord::resize(sf::Vector2u size, std::size_t bytes){
+    if (_id == 0) return;
+    std::lock_guard<std::mutex> lock(registryMutex);
+    ResourceInfo& info = resources[_id];
+    if (info.size == size && info.bytes == bytes) return;
+    total = total - info.bytes + bytes;
+    peak = std::max(peak, total);
+    info.size = size;
+    info.bytes = bytes;
+    ++revision;
+}
+
+std::shared_ptr<sf::Texture> ResourceMemory::makeTexture(){
+    return std::shared_ptr<sf::Texture>(new sf::Texture, TextureMemory{});
+}
+
+void ResourceMemory::trackTexture(const std::shared_ptr<sf::Texture>& texture, const std::string& group,
+                                  const std::string& owner, const std::string& name){
+    TextureMemory* memory = std::get_deleter<TextureMemory>(texture);
+    if (!memory) return;
+    sf::Vector2u size = texture->getSize();
+    memory->record = MemoryRecord({ResourceKind::TEXTURE, group, owner, name, size, textureBytes(size)});
+}
+
+void ResourceMemory::setBudget(std::size_t bytes){
+    std::lock_guard<std::mutex> lock(registryMutex);
+    budget = bytes;
+}
+
+std::size_t ResourceMemory::getBudget(){
+    std::lock_guard<std::mutex> lock(registryMutex);
+    return budget;
+}
+
+std::size_t ResourceMemory::totalBytes(){
+    std::lock_guard<std::mutex> lock(registryMutex);
+    return total;
+}
+
+std::size_t ResourceMemory::groupBytes(const std::string& group){
+    std::lock_guard<std::mutex> lock(registryMutex);
+    std::size_t bytes = 0;
+    for (const auto& [id, info] : resources){
+        if (info.group == group) bytes += info.bytes;
+    }
+    return bytes;
+}
+
+std::size_t ResourceMemory::peakBytes(){
+    std::lock_guard<std::mutex> lock(registryMutex);
+    return peak;
+}
+
+void ResourceMemory::resetPeak(){
+    std::lock_guard<std::mutex> lock(registryMutex);
+    peak = total;
+}
+
+std::uint64_t ResourceMemory::getRevision(){
+    return revision.load(std::memory_order_relaxed);
+}
+
+bool ResourceMemory::checkBudget(const std::string& group){
+    // Another level still waiting in the release queue is left out, a copy
+    // of this same map would be counted in though, so drain it first
+    std::size_t level = groupBytes(group);
+    std::size_t shared = groupBytes("");
+    std::size_t loadPeak = peakBytes();
+    std::size_t limit = getBudget();
+
+    LOG_INFO("Memory for " << group << ": " << megabytes(level) << " MB, " << megabytes(shared)
+             << " MB shared, " << megabytes(loadPeak) << " MB peak while loading, budget "
+             << megabytes(limit) << " MB");
+
+    bool fits = true;
+    if (level + shared > limit){
+        LOG_WARNING("Over the memory budget: " << group << " needs " << megabytes(level + shared)
+                    << " MB with the shared resources, the budget is " << megabytes(limit) << " MB");
+        fits = false;
+    }
+    if (loadPeak > limit){
+        LOG_WARNING("Over the memory budget while loading " << group << ": peaked at "
+                    << megabytes(loadPeak) << " MB, the previous level stays resident until the new one is in");
+        fits = false;
+    }
+    if (!fits) logReport();
+    return fits;
+}
+
+void ResourceMemory::logReport(std::size_t largest){
+    std::lock_guard<std::mutex> lock(registryMutex);
+    std::map<TotalKey, Total> totals = totalsLocked();
+
+    LOG_INFO("Resource memory: " << megabytes(total) << " MB in " << resources.size()
+             << " resources, peak " << megabytes(peak) << " MB, budget " << megabytes(budget) << " MB");
+    const std::string* group = nullptr;
+    for (const auto& [key, entry] : totals){
+        const auto& [entryGroup, owner, kind] = key;
+        if (!group || *group != entryGroup){
+            group = &entryGroup;
+            std::size_t bytes = 0;
+            for (const auto& [id, info] : resources){
+                if (info.group == entryGroup) bytes += info.bytes;
+            }
+            LOG_INFO("  " << groupName(entryGroup) << ": " << megabytes(bytes) << " MB");
+        }
+        LOG_INFO("    " << owner << " (" << kindName(kind) << "): " << entry.count << " x, "
+                 << megabytes(entry.bytes) << " MB");
+    }
+
+    std::vector<const ResourceInfo*> biggest;
+    for (const auto& [id, info] : resources){
+        biggest.push_back(&info);
+    }
+    std::sort(biggest.begin(), biggest.end(), [](const ResourceInfo* a, const ResourceInfo* b){
+        return a->bytes > b->bytes;
+    });
+    if (biggest.size() > largest) biggest.resize(largest);
+
+    LOG_INFO("  Largest:");
+    for (const ResourceInfo* info : biggest){
+        LOG_INFO("    " << info->name << " (" << info->owner << ", " << kindName(info->kind) << " "
+                 << info->size.x << "x" << info->size.y << "): " << megabytes(info->bytes) << " MB");
+    }
+}
+
+std::string ResourceMemory::summary(){
+    std::lock_guard<std::mutex> lock(registryMutex);
+    std::map<TotalKey, Total> totals = totalsLocked();
+
+    std::ostringstream text;
+    text.precision(2);
+    text << std::fixed << "Memory " << megabytes(total) << " / " << megabytes(budget) << " MB, peak "
+         << megabytes(peak) << " MB\n";
+    for (const auto& [key, entry] : totals){
+        const auto& [group, owner, kind] = key;
+        text << groupName(group) << "  " << owner << " " << kindName(kind) << "  " << entry.count
+             << " x  " << megabytes(entry.bytes) << " MB\n";
+    }
+    return text.str();
+}
@@ -0,0 +1,87 @@
+#pragma once
+#include <SFML/Graphics.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+// What a counted resource is. Textures live on the GPU, the rest in RAM
+enum class ResourceKind { TEXTURE, IMAGE, VERTICES, DATA };
+
+// One counted resource
+struct ResourceInfo {
+    ResourceKind kind = ResourceKind::DATA;
+    std::string group;   // map file for a level's resources, empty for shared ones
+    std::string owner;   // subsystem holding it, e.g. "Tilesets"
+    std::string name;    // file or part of the map it came from
+    sf::Vector2u size;   // pixels, {vertices, 1} for vertex data, {cells, layers} for map data
+    std::size_t bytes = 0;
+};
+
+// Handle of one resource in the accounting, counted from construction until
+// the handle goes. Move only, a default constructed one counts nothing
+class MemoryRecord {
+public:
+    MemoryRecord() = default;
+    explicit MemoryRecord(ResourceInfo info);
+    ~MemoryRecord();
+
+    MemoryRecord(MemoryRecord&& other) noexcept;
+    MemoryRecord& operator=(MemoryRecord&& other) noexcept;
+    MemoryRecord(const MemoryRecord&) = delete;
+    MemoryRecord& operator=(const MemoryRecord&) = delete;
+
+    bool isCounted() const { return _id != 0; }
+
+    // The resource was reloaded or patched and changed size
+    void resize(sf::Vector2u size, std::size_t bytes);
+
+private:
+    std::uint64_t _id = 0;
+};
+
+// Every texture, decoded image and vertex array the game holds, with the
+// subsystem and level it belongs to, so a level's memory cost is known
+// before it runs on a small device. Records may come and go on any thread
+class ResourceMemory {
+public:
+    // What the smallest devices we ship on can spare
+    static const std::size_t DEFAULT_BUDGET = (std::size_t)512 * 1024 * 1024;
+
+    // RGBA8, which is what SFML uploads every texture as
+    static std::size_t textureBytes(sf::Vector2u size) { return (std::size_t)size.x * size.y * 4; }
+
+    // An empty texture that stays counted for as long as any shared_ptr to
+    // it lives, the release queue's included. Count it with trackTexture
+    // once it is loaded
+    static std::shared_ptr<sf::Texture> makeTexture();
+    // Counts a texture from makeTexture at its current size, again after a
+    // reload changed it. Others are left alone
+    static void trackTexture(const std::shared_ptr<sf::Texture>& texture, const std::string& group,
+                             const std::string& owner, const std::string& name);
+
+    static void setBudget(std::size_t bytes);
+    static std::size_t getBudget();
+
+    // Bytes counted now, in total and for one group
+    static std::size_t totalBytes();
+    static std::size_t groupBytes(const std::string& group);
+
+    // Most bytes counted at once since the last resetPeak
+    static std::size_t peakBytes();
+    static void resetPeak();
+
+    // Bumped by every change, to tell when a summary is out of date
+    static std::uint64_t getRevision();
+
+    // Call once a level is loaded, group being its map file. Warns if the
+    // level and the shared resources together, or the peak while loading
+    // it, go over the budget. False if anything did
+    static bool checkBudget(const std::string& group);
+
+    // Totals per group, owner and kind, then the largest resources
+    static void logReport(std::size_t largest = 10);
+
+    // A few lines per group for the memory overlay
+    static std::string summary();
+};
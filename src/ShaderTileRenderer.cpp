@@ -0,0 +1,211 @@
+#include "ShaderTileRenderer.hpp"
+#include "Log.hpp"
+#include <algorithm>
+#include <string>
+
+static const char* VERTEX_SHADER = R"(
+varying vec2 worldPos;
+
+void main(){
+    worldPos = gl_MultiTexCoord0.xy;
+    gl_Position = gl_ModelViewProjectionMatrix * gl_Vertex;
+    gl_FrontColor = gl_Color;
+}
+)";
+
+// GLSL 1.10 can't index an array of samplers with a variable, hence the
+// chain of ifs over one sampler per tileset
+static const char* FRAGMENT_SHADER = R"(
+uniform sampler2D lookup;
+uniform vec2 mapSize;
+uniform vec2 tileSize;
+uniform sampler2D atlas0;
+uniform sampler2D atlas1;
+uniform sampler2D atlas2;
+uniform sampler2D atlas3;
+uniform sampler2D atlas4;
+uniform sampler2D atlas5;
+uniform sampler2D atlas6;
+uniform vec2 atlasSize0;
+uniform vec2 atlasSize1;
+uniform vec2 atlasSize2;
+uniform vec2 atlasSize3;
+uniform vec2 atlasSize4;
+uniform vec2 atlasSize5;
+uniform vec2 atlasSize6;
+uniform vec2 tileFrames[32];
+uniform float tilesetSolid[7];
+uniform float solidPass;
+varying vec2 worldPos;
+
+void main(){
+    vec2 cell = floor(worldPos / tileSize);
+    if (cell.x < 0.0 || cell.y < 0.0 || cell.x >= mapSize.x || cell.y >= mapSize.y) discard;
+
+    vec4 entry = floor(texture2D(lookup, (cell + 0.5) / mapSize) * 255.0 + 0.5);
+    if (entry.b < 0.5) discard;
+    // solid tilesets go in the collision pass, the rest in the background one
+    if (tilesetSolid[int(entry.b) - 1] != solidPass) discard;
+
+    // animated tiles show whatever frame their animation is on
+    vec2 tile = entry.rg;
+    if (entry.a > 0.5) tile = tileFrames[int(entry.a) - 1];
+
+    // centre of the matching atlas pixel, nearest filtering by hand
+    vec2 pixel = tile * tileSize + floor(worldPos - cell * tileSize) + 0.5;
+    vec4 color;
+    if (entry.b < 1.5) color = texture2D(atlas0, pixel / atlasSize0);
+    else if (entry.b < 2.5) color = texture2D(atlas1, pixel / atlasSize1);
+    else if (entry.b < 3.5) color = texture2D(atlas2, pixel / atlasSize2);
+    else if (entry.b < 4.5) color = texture2D(atlas3, pixel / atlasSize3);
+    else if (entry.b < 5.5) color = texture2D(atlas4, pixel / atlasSize4);
+    else if (entry.b < 6.5) color = texture2D(atlas5, pixel / atlasSize5);
+    else color = texture2D(atlas6, pixel / atlasSize6);
+
+    gl_FragColor = color * gl_Color;
+}
+)";
+
+// One RGBA texel per cell: atlas column, atlas row, tileset + 1 (0 for
+// nothing to draw), animation + 1 (0 for a still tile). Cells the chunk
+// meshes would skip are left empty too
+static void lookupTexel(const MapData& map, std::size_t layer, int x, int y, std::uint8_t* texel){
+    std::fill(texel, texel + 4, 0);
+    std::uint32_t gid = map.layers[layer].data[(std::size_t)y * map.width + x] & GID_MASK;
+    if (gid == 0 || map.isCellHidden(layer, x, y)) return;
+
+    int tilesetIdx = map.findTileset(gid);
+    if (tilesetIdx < 0) return;
+    const TilesetInfo& tileset = map.tilesets[tilesetIdx];
+
+    int local = (int)gid - tileset.firstGid;
+    texel[0] = (std::uint8_t)(local % tileset.columns);
+    texel[1] = (std::uint8_t)(local / tileset.columns);
+    texel[2] = (std::uint8_t)(tilesetIdx + 1);
+    texel[3] = (std::uint8_t)(map.findAnimation(gid) + 1);
+}
+
+bool ShaderTileRenderer::build(const MapData& map){
+    _map = nullptr;
+    _shader.reset();
+    _lookups.clear();
+
+    if (!sf::Shader::isAvailable()) return false;
+    if (map.tilesets.size() > MAX_TILESETS) return false;
+    if (map.animations.size() > MAX_ANIMATIONS) return false;
+    if (map.width <= 0 || map.height <= 0) return false;
+    unsigned maxSize = sf::Texture::getMaximumSize();
+    if ((unsigned)map.width > maxSize || (unsigned)map.height > maxSize) return false;
+
+    // The shader fills whole cells, so every tile has to be exactly one
+    // cell, and any tile of the tileset has to fit a byte's worth of
+    // columns and rows since cells can be changed to any of them later
+    for (const auto& tileset : map.tilesets){
+        if (!tileset.texture || tileset.columns <= 0) return false;
+        if (tileset.tileWidth != map.tileWidth || tileset.tileHeight != map.tileHeight) return false;
+        if (tileset.columns > 256 || (tileset.tileCount + tileset.columns - 1) / tileset.columns > 256) return false;
+    }
+
+    std::vector<std::uint8_t> pixels((std::size_t)map.width * map.height * 4);
+    for (std::size_t layer = 0; layer < map.layers.size(); ++layer){
+        for (int y = 0; y < map.height; ++y){
+            for (int x = 0; x < map.width; ++x){
+                lookupTexel(map, layer, x, y, &pixels[((std::size_t)y * map.width + x) * 4]);
+            }
+        }
+
+        auto lookup = ResourceMemory::makeTexture();
+        if (!lookup->resize({(unsigned)map.width, (unsigned)map.height})){
+            _lookups.clear();
+            return false;
+        }
+        lookup->update(pixels.data());
+        ResourceMemory::trackTexture(lookup, map.path, "Tile shader", map.layers[layer].name + " lookup");
+        _lookups.push_back(std::move(lookup));
+    }
+
+    auto shader = std::make_unique<sf::Shader>();
+    if (!shader->loadFromMemory(VERTEX_SHADER, FRAGMENT_SHADER)){
+        LOG_WARNING("Tile shader failed to compile, drawing chunk meshes instead");
+        _lookups.clear();
+        return false;
+    }
+    shader->setUniform("mapSize", sf::Glsl::Vec2((float)map.width, (float)map.height));
+    shader->setUniform("tileSize", sf::Glsl::Vec2((float)map.tileWidth, (float)map.tileHeight));
+    for (std::size_t t = 0; t < map.tilesets.size(); ++t){
+        const sf::Texture& atlas = *map.tilesets[t].texture;
+        shader->setUniform("atlas" + std::to_string(t), atlas);
+        shader->setUniform("atlasSize" + std::to_string(t), sf::Glsl::Vec2(atlas.getSize()));
+    }
+    float solid[MAX_TILESETS] = {};
+    for (std::size_t t = 0; t < map.tilesets.size(); ++t){
+        solid[t] = map.tilesets[t].solid ? 1.f : 0.f;
+    }
+    shader->setUniformArray("tilesetSolid", solid, MAX_TILESETS);
+
+    _shader = std::move(shader);
+    _map = &map;
+    _frameTiles.assign(map.animations.size(), sf::Glsl::Vec2());
+    setAnimationFrames(std::vector<int>(map.animations.size(), -1));
+    return true;
+}
+
+void ShaderTileRenderer::updateCell(int x, int y){
+    if (!_shader) return;
+    std::uint8_t texel[4];
+    for (std::size_t layer = 0; layer < _lookups.size(); ++layer){
+        lookupTexel(*_map, layer, x, y, texel);
+        _lookups[layer]->update(texel, {1, 1}, {(unsigned)x, (unsigned)y});
+    }
+}
+
+void ShaderTileRenderer::setAnimationFrames(const std::vector<int>& frames){
+    if (!_shader || _frameTiles.empty()) return;
+    for (std::size_t i = 0; i < _frameTiles.size(); ++i){
+        const TileAnimation& animation = _map->animations[i];
+        const TilesetInfo& tileset = _map->tilesets[animation.tileset];
+        int local = frames[i] >= 0 ? frames[i] : (int)animation.gid - tileset.firstGid;
+        _frameTiles[i] = sf::Glsl::Vec2((float)(local % tileset.columns), (float)(local / tileset.columns));
+    }
+    _shader->setUniformArray("tileFrames", _frameTiles.data(), _frameTiles.size());
+}
+
+void ShaderTileRenderer::drawLayer(sf::RenderTarget& target, std::size_t layer, bool solid) const{
+    if (!_shader || layer >= _lookups.size()) return;
+
+    // Only the part of the view the map covers
+    const sf::View& view = target.getView();
+    sf::Vector2f topLeft = view.getCenter() - view.getSize() / 2.f;
+    sf::Vector2f bottomRight = view.getCenter() + view.getSize() / 2.f;
+    float left = std::max(topLeft.x, 0.f);
+    float top = std::max(topLeft.y, 0.f);
+    float right = std::min(bottomRight.x, (float)(_map->width * _map->tileWidth));
+    float bottom = std::min(bottomRight.y, (float)(_map->height * _map->tileHeight));
+    if (left >= right || top >= bottom) return;
+
+    // texture coordinates are world pixels, the shader does the rest
+    sf::Vertex quad[6];
+    quad[0].position = {left, top};
+    quad[1].position = {right, top};
+    quad[2].position = {left, bottom};
+    quad[3].position = {left, bottom};
+    quad[4].position = {right, top};
+    quad[5].position = {right, bottom};
+    for (auto& vertex : quad) vertex.texCoords = vertex.position;
+
+    _shader->setUniform("lookup", *_lookups[layer]);
+    _shader->setUniform("solidPass", solid ? 1.f : 0.f);
+    sf::RenderStates states;
+    states.shader = _shader.get();
+    target.draw(quad, 6, sf::PrimitiveType::Triangles, states);
+}
+
+void ShaderTileRenderer::release(ReleaseQueue& queue){
+    queue.defer(std::move(_shader));
+    for (auto& lookup : _lookups){
+        queue.defer(std::move(lookup));
+    }
+    _lookups.clear();
+    _frameTiles.clear();
+    _map = nullptr;
+}
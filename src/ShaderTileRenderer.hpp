@@ -0,0 +1,57 @@
+#pragma once
+#include <SFML/Graphics.hpp>
+#include <memory>
+#include <vector>
+
+#include "TileChunk.hpp"
+#include "ReleaseQueue.hpp"
+
+// Draws a whole tile layer as one quad over the view. Every layer's grid is
+// uploaded once as a lookup texture, one texel per cell holding the atlas
+// column, row and tileset of its tile, and a fragment shader picks the
+// atlas pixel for each screen pixel. Draw calls and vertex work stay the
+// same no matter how many tiles are on screen or how big the map is.
+//
+// The shaders stick to GLSL 1.10 so they also run on Mesa's llvmpipe.
+// build() refuses maps it can't draw exactly like the chunk meshes would
+// (no shader support, too many tilesets, tiles that aren't one cell, grids
+// bigger than the largest texture), the caller keeps using meshes then
+class ShaderTileRenderer {
+public:
+    // Samplers the fragment shader has, one per tileset. With the lookup
+    // texture that keeps the shader within 8 texture units
+    static const std::size_t MAX_TILESETS = 7;
+    // Animated gids, the shader keeps the frame of each in a uniform array
+    // the lookup texel points into
+    static const std::size_t MAX_ANIMATIONS = 32;
+
+    ShaderTileRenderer() = default;
+
+    // Uploads the lookup textures and compiles the shader. False if this
+    // map needs the mesh path, nothing is kept in that case
+    bool build(const MapData& map);
+
+    bool isReady() const { return _shader != nullptr; }
+
+    // Uploads the texels of one cell again after it was changed, every
+    // layer since covering tiles hide the ones under them. Call with the
+    // map's edit lock held
+    void updateCell(int x, int y);
+
+    // Sets the local tile id each animation shows (-1 for its own tile),
+    // one uniform upload however many cells use them
+    void setAnimationFrames(const std::vector<int>& frames);
+
+    // Draws the part of the layer inside the target's view, only the
+    // tiles of solid tilesets or only the others
+    void drawLayer(sf::RenderTarget& target, std::size_t layer, bool solid) const;
+
+    // Hand the shader and lookup textures over to the release queue
+    void release(ReleaseQueue& queue);
+
+private:
+    const MapData* _map = nullptr;
+    std::unique_ptr<sf::Shader> _shader;
+    std::vector<std::shared_ptr<sf::Texture>> _lookups; // one per layer, counted in the resource memory
+    std::vector<sf::Glsl::Vec2> _frameTiles; // atlas tile of each animation's frame, sized in build()
+};
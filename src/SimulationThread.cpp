@@ -0,0 +1,46 @@
+#include "SimulationThread.hpp"
+#include "AllocationTracker.hpp"
+#include <chrono>
+
+void SimulationThread::start(unsigned rate, Step step){
+    stop();
+    _stop = false;
+    _running = true;
+    _dropped = 0;
+    _allocating = 0;
+    _thread = std::thread(&SimulationThread::run, this, rate, std::move(step));
+}
+
+void SimulationThread::stop(){
+    _stop = true;
+    if (_thread.joinable()) _thread.join();
+    _running = false;
+}
+
+void SimulationThread::run(unsigned rate, Step step){
+    using Clock = std::chrono::steady_clock;
+    const Clock::duration period = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / rate));
+    const Clock::time_point origin = Clock::now();
+
+    std::uint64_t tick = 0;
+    while (!_stop){
+        Clock::time_point due = origin + period * (tick + 1);
+        std::this_thread::sleep_until(due);
+
+        // too far behind, skip to the tick that is due now
+        std::uint64_t current = (std::uint64_t)((Clock::now() - origin) / period);
+        if (current > tick + 1 + MAX_CATCH_UP){
+            _dropped += current - 1 - tick;
+            tick = current - 1;
+        }
+
+        if (_stop) break;
+        AllocationCounts before = AllocationTracker::threadCounts();
+        bool carryOn = step(tick);
+        AllocationCounts after = AllocationTracker::threadCounts();
+        if (tick >= WARMUP_TICKS && after.allocations - after.expected > before.allocations - before.expected) ++_allocating;
+        if (!carryOn) break;
+        ++tick;
+    }
+    _running = false;
+}
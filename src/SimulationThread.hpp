@@ -0,0 +1,51 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <thread>
+
+// Runs a step function at a fixed rate on its own thread, so the
+// simulation keeps its pace however long frames take to draw. Tick n is
+// run once n + 1 periods have passed since start(). A step that falls more
+// than MAX_CATCH_UP ticks behind drops the missed ticks instead of running
+// them back to back
+class SimulationThread {
+public:
+    // Returns false to stop the thread, e.g. when the level is over
+    using Step = std::function<bool(std::uint64_t tick)>;
+
+    static const int MAX_CATCH_UP = 5;
+    // Ticks that may allocate before getAllocatingTicks starts counting
+    static const std::uint64_t WARMUP_TICKS = 120;
+
+    SimulationThread() = default;
+    ~SimulationThread() { stop(); }
+
+    SimulationThread(const SimulationThread&) = delete;
+    SimulationThread& operator=(const SimulationThread&) = delete;
+
+    // Stops any running step first
+    void start(unsigned rate, Step step);
+
+    // Waits for the current tick to finish, the step's data is then free to
+    // touch from the calling thread
+    void stop();
+
+    bool isRunning() const { return _running; }
+
+    // Ticks dropped because the step couldn't keep up, since start()
+    std::uint64_t getDroppedTicks() const { return _dropped; }
+
+    // Ticks past warm-up whose step allocated, since start(). Always 0
+    // unless the allocation tracker is built in
+    std::uint64_t getAllocatingTicks() const { return _allocating; }
+
+private:
+    void run(unsigned rate, Step step);
+
+    std::atomic<bool> _stop{false};
+    std::atomic<bool> _running{false};
+    std::atomic<std::uint64_t> _dropped{0};
+    std::atomic<std::uint64_t> _allocating{0};
+    std::thread _thread;
+};
@@ -0,0 +1,31 @@
+#include "SpatialHash.hpp"
+#include <algorithm>
+
+void SpatialHash::reset(std::size_t bucketCount){
+    std::size_t size = 1;
+    while (size < bucketCount) size <<= 1;
+
+    // keep the buckets' storage around when the size does not change
+    if (_buckets.size() != size){
+        _buckets.assign(size, {});
+    }
+    else {
+        for (auto& bucket : _buckets) bucket.clear();
+    }
+    _mask = size - 1;
+}
+
+void SpatialHash::insert(std::uint32_t item, int cellX, int cellY){
+    _buckets[bucketIndex(cellX, cellY)].push_back(item);
+}
+
+void SpatialHash::remove(std::uint32_t item, int cellX, int cellY){
+    // an item sits in a bucket once per cell of its that hashes there,
+    // dropping any one copy is fine
+    std::vector<std::uint32_t>& bucket = _buckets[bucketIndex(cellX, cellY)];
+    auto it = std::find(bucket.begin(), bucket.end(), item);
+    if (it != bucket.end()){
+        *it = bucket.back();
+        bucket.pop_back();
+    }
+}
@@ -0,0 +1,32 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+// Uniform grid of cells hashed into a fixed number of buckets, so an
+// unbounded level costs no more memory than the bodies in it. Items are
+// kept in every bucket their cells hash to and only move when they cross
+// a cell edge. Different cells can share a bucket, callers filter those
+// out by checking the cell themselves
+class SpatialHash {
+public:
+    SpatialHash() = default;
+
+    // Drops every item and resizes to at least bucketCount buckets
+    void reset(std::size_t bucketCount);
+
+    void insert(std::uint32_t item, int cellX, int cellY);
+    void remove(std::uint32_t item, int cellX, int cellY);
+
+    // Items in the bucket cell (cellX, cellY) hashes to
+    const std::vector<std::uint32_t>& getBucket(int cellX, int cellY) const { return _buckets[bucketIndex(cellX, cellY)]; }
+
+private:
+    std::vector<std::vector<std::uint32_t>> _buckets;
+    std::size_t _mask = 0;
+
+    std::size_t bucketIndex(int cellX, int cellY) const {
+        std::uint32_t h = static_cast<std::uint32_t>(cellX) * 73856093u ^ static_cast<std::uint32_t>(cellY) * 19349663u;
+        return h & _mask;
+    }
+};
@@ -1,6 +1,5 @@
 #pragma once
 #include <string>
-#include <SFML/Graphics.hpp>
 
 enum class TileType {
     NONE,
@@ -13,41 +12,23 @@ enum class TileType {
     // Add more types as needed
 };
 
-class Tile {
-public:
-    // Hardcoded tile ID constants
-    static const int SPIKE_ID = 1330;
-    static const int SPIKE_ID2 = 1329;
-
-    
-    Tile() : _type(TileType::NONE), _id(0), _gridX(0), _gridY(0) {}
-    
-    Tile(int id, int gridX, int gridY, sf::FloatRect bounds)
-        : _id(id), _gridX(gridX), _gridY(gridY), _bounds(bounds) {
-        _type = idToType(id);
-    }
-    
-    // Getters
-    TileType getType() const { return _type; }
-    int getId() const { return _id; }
-    int getGridX() const { return _gridX; }
-    int getGridY() const { return _gridY; }
-    sf::FloatRect getBounds() const { return _bounds; }
-    
-    // Check tile type
-    bool isType(TileType type) const { return _type == type; }
-    bool isNone() const { return _type == TileType::NONE; }
-    
-private:
-    TileType _type;
-    int _id;
-    int _gridX;
-    int _gridY;
-    sf::FloatRect _bounds;
-    
-    // Convert tile ID to type
-    static TileType idToType(int id) {
-        if (id == SPIKE_ID || id ==SPIKE_ID2) return TileType::SPIKE;
-        return TileType::GROUND; // Default to ground for any collision tile
-    }
+// Per gid behaviour, read from the tileset's tiles[].properties in Tiled.
+// Tiles without properties are plain ground, solid if their tileset is
+struct TileProperties {
+    TileType type = TileType::GROUND;
+    bool solid = false;   // blocks movement, from the tileset's "solid" property
+    float friction = 1.f; // scales how quickly the player slows down on it
+    float bounce = 0.f;   // fraction of landing speed given back upwards
+    int damage = 0;       // lives lost on touching it
 };
+
+// Parses a Tiled "type" value ("spike", "bounce_pad", ...), GROUND if unknown
+inline TileType tileTypeFromString(const std::string& name){
+    if (name == "none") return TileType::NONE;
+    if (name == "spike") return TileType::SPIKE;
+    if (name == "lava") return TileType::LAVA;
+    if (name == "ice") return TileType::ICE;
+    if (name == "bounce_pad") return TileType::BOUNCE_PAD;
+    if (name == "checkpoint") return TileType::CHECKPOINT;
+    return TileType::GROUND;
+}
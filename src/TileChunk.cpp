@@ -0,0 +1,265 @@
+#include "TileChunk.hpp"
+
+#include <algorithm>
+#include <string>
+
+int MapData::findTileset(std::uint32_t gid) const{
+    gid &= GID_MASK;
+    for (int i = (int)tilesets.size() - 1; i >= 0; --i){
+        if ((int)gid >= tilesets[i].firstGid){
+            if ((int)gid < tilesets[i].firstGid + tilesets[i].tileCount) return i;
+            return -1;
+        }
+    }
+    return -1;
+}
+
+const TileProperties& MapData::getProperties(std::uint32_t gid) const{
+    static const TileProperties empty{TileType::NONE};
+    gid &= GID_MASK;
+    if (gid == 0 || gid >= tileProperties.size()) return empty;
+    return tileProperties[gid];
+}
+
+void MapData::buildPropertyTable(){
+    int maxGid = 0;
+    for (const auto& tileset : tilesets){
+        maxGid = std::max(maxGid, tileset.firstGid + tileset.tileCount - 1);
+    }
+
+    tileProperties.assign(maxGid + 1, TileProperties());
+    tileProperties[0].type = TileType::NONE;
+    tileOpaque.assign(maxGid + 1, 0);
+    for (const auto& tileset : tilesets){
+        for (int localId = 0; localId < tileset.tileCount; ++localId){
+            tileProperties[tileset.firstGid + localId].solid = tileset.solid;
+        }
+        for (const auto& [localId, properties] : tileset.tileProperties){
+            if (localId >= 0 && localId < tileset.tileCount){
+                tileProperties[tileset.firstGid + localId] = properties;
+                tileProperties[tileset.firstGid + localId].solid = tileset.solid;
+            }
+        }
+
+        // smaller tiles leave part of the cell uncovered however solid they are
+        if (tileset.tileWidth < tileWidth || tileset.tileHeight < tileHeight) continue;
+        int count = std::min(tileset.tileCount, (int)tileset.opaqueTiles.size());
+        for (int localId = 0; localId < count; ++localId){
+            tileOpaque[tileset.firstGid + localId] = tileset.opaqueTiles[localId];
+        }
+    }
+
+    // Animated tiles, opaque only if every frame is
+    animations.clear();
+    tileAnimation.assign(maxGid + 1, -1);
+    for (std::size_t t = 0; t < tilesets.size(); ++t){
+        const TilesetInfo& tileset = tilesets[t];
+        for (const auto& [localId, frames] : tileset.tileAnimations){
+            if (localId < 0 || localId >= tileset.tileCount || frames.empty()) continue;
+
+            TileAnimation animation;
+            animation.gid = (std::uint32_t)(tileset.firstGid + localId);
+            animation.tileset = (int)t;
+            bool opaque = true;
+            for (const auto& frame : frames){
+                if (frame.tileId < 0 || frame.tileId >= tileset.tileCount) continue;
+                animation.frames.push_back(frame);
+                animation.totalDuration += std::max(frame.duration, 1);
+                opaque = opaque && tileOpaque[tileset.firstGid + frame.tileId];
+            }
+            if (animation.frames.empty()) continue;
+
+            tileOpaque[animation.gid] = opaque;
+            tileAnimation[animation.gid] = (int)animations.size();
+            animations.push_back(std::move(animation));
+        }
+    }
+}
+
+int TileAnimation::frameAt(std::int64_t time) const{
+    std::int64_t into = time % totalDuration;
+    for (const auto& frame : frames){
+        into -= std::max(frame.duration, 1);
+        if (into < 0) return frame.tileId;
+    }
+    return frames.back().tileId;
+}
+
+bool MapData::isCellHidden(std::size_t layer, int x, int y) const{
+    std::size_t cell = (std::size_t)y * width + x;
+    std::uint32_t gid = layers[layer].data[cell] & GID_MASK;
+    if (gid == 0) return false;
+
+    int tilesetIdx = findTileset(gid);
+    if (tilesetIdx < 0) return false;
+    if (tilesets[tilesetIdx].tileWidth > tileWidth || tilesets[tilesetIdx].tileHeight > tileHeight) return false;
+
+    // covered by an opaque tile of another layer that is drawn later
+    std::size_t rank = drawRank(layer, tilesetIdx);
+    for (std::size_t other = 0; other < layers.size(); ++other){
+        std::uint32_t cover = layers[other].data[cell];
+        if (other == layer || !isOpaque(cover)) continue;
+        int coverTileset = findTileset(cover);
+        if (coverTileset >= 0 && drawRank(other, coverTileset) > rank) return true;
+    }
+    return false;
+}
+
+// Tileset of the quad a cell's tile is drawn with, -1 if it isn't drawn
+static int drawnTileset(const MapData& map, std::size_t layer, int x, int y){
+    std::uint32_t gid = map.layers[layer].data[(std::size_t)y * map.width + x] & GID_MASK;
+    if (gid == 0) return -1;
+
+    // covered by an opaque tile drawn later, filling it is wasted work
+    if (map.isCellHidden(layer, x, y)) return -1;
+    return map.findTileset(gid);
+}
+
+// Points a quad at another tile of its tileset, positions stay
+static void setQuadTile(sf::VertexArray& va, std::size_t vertex, const TilesetInfo& tileset, int local){
+    float u = (float)((local % tileset.columns) * tileset.tileWidth);
+    float v = (float)((local / tileset.columns) * tileset.tileHeight);
+    float w = (float)tileset.tileWidth;
+    float h = (float)tileset.tileHeight;
+    va[vertex + 0].texCoords = {u, v};
+    va[vertex + 1].texCoords = {u + w, v};
+    va[vertex + 2].texCoords = {u, v + h};
+    va[vertex + 3].texCoords = {u, v + h};
+    va[vertex + 4].texCoords = {u + w, v};
+    va[vertex + 5].texCoords = {u + w, v + h};
+}
+
+// Writes the six vertices of a cell's tile starting at vertex
+static void writeQuad(sf::VertexArray& va, std::size_t vertex, const MapData& map, const TilesetInfo& tileset, std::uint32_t gid, int x, int y){
+    int local = (int)(gid & GID_MASK) - tileset.firstGid;
+    float u = (float)((local % tileset.columns) * tileset.tileWidth);
+    float v = (float)((local / tileset.columns) * tileset.tileHeight);
+    float w = (float)tileset.tileWidth;
+    float h = (float)tileset.tileHeight;
+
+    // Tiled anchors oversized tiles to the bottom left of their cell
+    float left = (float)(x * map.tileWidth);
+    float top = (float)((y + 1) * map.tileHeight) - h;
+
+    va[vertex + 0] = {{left, top}, sf::Color::White, {u, v}};
+    va[vertex + 1] = {{left + w, top}, sf::Color::White, {u + w, v}};
+    va[vertex + 2] = {{left, top + h}, sf::Color::White, {u, v + h}};
+    va[vertex + 3] = {{left, top + h}, sf::Color::White, {u, v + h}};
+    va[vertex + 4] = {{left + w, top}, sf::Color::White, {u + w, v}};
+    va[vertex + 5] = {{left + w, top + h}, sf::Color::White, {u + w, v + h}};
+}
+
+// Counts the mesh's vertices and bookkeeping under the map's file, or
+// updates the count after cells were patched
+static void countMemory(ChunkMesh& mesh, const MapData& map){
+    std::size_t vertices = 0;
+    std::size_t bytes = mesh.animated.size() * sizeof(AnimatedQuad);
+    for (std::size_t layer = 0; layer < mesh.layers.size(); ++layer){
+        for (const auto& va : mesh.layers[layer]) vertices += va.getVertexCount();
+        bytes += mesh.cells[layer].size() * sizeof(CellQuad);
+    }
+    bytes += vertices * sizeof(sf::Vertex);
+
+    sf::Vector2u size = {(unsigned)vertices, 1};
+    if (mesh.memory.isCounted()){
+        mesh.memory.resize(size, bytes);
+        return;
+    }
+    std::string name = "chunk " + std::to_string(mesh.chunkX) + "," + std::to_string(mesh.chunkY);
+    mesh.memory = MemoryRecord({ResourceKind::VERTICES, map.path, "Chunk meshes", name, size, bytes});
+}
+
+ChunkMesh buildChunkMesh(const MapData& map, int chunkX, int chunkY){
+    std::lock_guard<std::mutex> lock(map.editMutex);
+
+    ChunkMesh mesh;
+    mesh.chunkX = chunkX;
+    mesh.chunkY = chunkY;
+    mesh.revision = map.revision;
+    mesh.layers.resize(map.layers.size());
+    mesh.cells.resize(map.layers.size());
+
+    int startX = chunkX * CHUNK_SIZE;
+    int startY = chunkY * CHUNK_SIZE;
+    int endX = std::min(startX + CHUNK_SIZE, map.width);
+    int endY = std::min(startY + CHUNK_SIZE, map.height);
+
+    for (std::size_t layerIdx = 0; layerIdx < map.layers.size(); ++layerIdx){
+        const auto& data = map.layers[layerIdx].data;
+        auto& arrays = mesh.layers[layerIdx];
+        arrays.assign(map.tilesets.size(), sf::VertexArray(sf::PrimitiveType::Triangles));
+        auto& cells = mesh.cells[layerIdx];
+        cells.assign(CHUNK_SIZE * CHUNK_SIZE, CellQuad());
+
+        for (int y = startY; y < endY; ++y){
+            for (int x = startX; x < endX; ++x){
+                int tilesetIdx = drawnTileset(map, layerIdx, x, y);
+                if (tilesetIdx < 0) continue;
+
+                sf::VertexArray& va = arrays[tilesetIdx];
+                CellQuad& quad = cells[(y - startY) * CHUNK_SIZE + (x - startX)];
+                quad.tileset = tilesetIdx;
+                quad.vertex = va.getVertexCount();
+                va.resize(quad.vertex + 6);
+                writeQuad(va, quad.vertex, map, map.tilesets[tilesetIdx], data[y * map.width + x], x, y);
+
+                int animation = map.findAnimation(data[y * map.width + x]);
+                if (animation >= 0) mesh.animated.push_back({animation, layerIdx, tilesetIdx, quad.vertex});
+            }
+        }
+    }
+    countMemory(mesh, map);
+    return mesh;
+}
+
+// Zero area, all six vertices on one point
+static void collapseQuad(sf::VertexArray& va, std::size_t vertex){
+    for (std::size_t i = 1; i < 6; ++i) va[vertex + i] = va[vertex];
+}
+
+void updateCellQuads(ChunkMesh& mesh, const MapData& map, int x, int y){
+    std::size_t cell = (std::size_t)(y - mesh.chunkY * CHUNK_SIZE) * CHUNK_SIZE + (x - mesh.chunkX * CHUNK_SIZE);
+    for (std::size_t layerIdx = 0; layerIdx < mesh.layers.size(); ++layerIdx){
+        auto& arrays = mesh.layers[layerIdx];
+        CellQuad& quad = mesh.cells[layerIdx][cell];
+        int tilesetIdx = drawnTileset(map, layerIdx, x, y);
+
+        if (quad.tileset >= 0 && quad.tileset != tilesetIdx){
+            collapseQuad(arrays[quad.tileset], quad.vertex);
+        }
+
+        // whatever the cell showed before doesn't animate any more
+        if (quad.tileset >= 0){
+            auto& animated = mesh.animated;
+            animated.erase(std::remove_if(animated.begin(), animated.end(), [&](const AnimatedQuad& entry){
+                return entry.layer == layerIdx && entry.tileset == quad.tileset && entry.vertex == quad.vertex;
+            }), animated.end());
+        }
+        if (tilesetIdx < 0) continue;
+
+        // A new tileset for this cell goes at the end of that tileset's
+        // array, otherwise the old slot is reused in place
+        sf::VertexArray& va = arrays[tilesetIdx];
+        if (quad.tileset != tilesetIdx){
+            if (quad.tileset >= 0) ++mesh.abandonedQuads;
+            quad.tileset = tilesetIdx;
+            quad.vertex = va.getVertexCount();
+            va.resize(quad.vertex + 6);
+        }
+        std::uint32_t gid = map.layers[layerIdx].data[(std::size_t)y * map.width + x];
+        writeQuad(va, quad.vertex, map, map.tilesets[tilesetIdx], gid, x, y);
+
+        int animation = map.findAnimation(gid);
+        if (animation >= 0) mesh.animated.push_back({animation, layerIdx, tilesetIdx, quad.vertex});
+    }
+    countMemory(mesh, map);
+}
+
+void animateChunk(ChunkMesh& mesh, const MapData& map, const std::vector<int>& frames, const std::vector<std::uint8_t>* changed){
+    for (const auto& entry : mesh.animated){
+        if (changed && !(*changed)[entry.animation]) continue;
+        int frame = frames[entry.animation];
+        if (frame < 0) continue;
+        setQuadTile(mesh.layers[entry.layer][entry.tileset], entry.vertex, map.tilesets[entry.tileset], frame);
+    }
+}
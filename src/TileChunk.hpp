@@ -0,0 +1,167 @@
+#pragma once
+#include <SFML/Graphics.hpp>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <utility>
+
+#include "Tile.hpp"
+#include "ResourceMemory.hpp"
+
+// Width and height of a streaming chunk in tiles, same as Tiled's default
+// chunk size for infinite maps
+const int CHUNK_SIZE = 16;
+
+// Tiled keeps the flip flags in the top three bits of a gid
+const std::uint32_t GID_MASK = 0x1FFFFFFF;
+
+// One frame of a Tiled tile animation
+struct TileFrame {
+    int tileId = 0;   // local id in the same tileset
+    int duration = 0; // milliseconds
+};
+
+// The frames a gid cycles through. Every tile with that gid shows the same
+// frame, all of them run off the TileMap's one animation clock
+struct TileAnimation {
+    std::uint32_t gid = 0;
+    int tileset = 0;
+    std::vector<TileFrame> frames;
+    int totalDuration = 0;
+
+    // Local tile id showing at time milliseconds into the clock
+    int frameAt(std::int64_t time) const;
+};
+
+// A tileset image and the range of gids it covers
+struct TilesetInfo {
+    std::string source;
+    std::string path;       // tileset file and its image as loaded, for hot reload
+    std::string imagePath;
+    int firstGid = 0;
+    int tileCount = 0;
+    int columns = 0;
+    int tileWidth = 0;
+    int tileHeight = 0;
+    std::shared_ptr<sf::Texture> texture;
+    bool solid = false; // its tiles block movement and draw with the collision tiles
+    std::vector<std::pair<int, TileProperties>> tileProperties; // by local tile id
+    std::vector<std::uint8_t> opaqueTiles; // by local tile id, 1 if no pixel lets anything through
+    std::vector<std::pair<int, std::vector<TileFrame>>> tileAnimations; // by local tile id
+};
+
+// One tile layer stored as a dense row major grid of gids
+struct TileLayer {
+    std::string name;
+    int id = 0;
+    std::vector<std::uint32_t> data;
+};
+
+// Map description shared read only between the TileMap and the streaming thread
+struct MapData {
+    std::string path; // file it was loaded from, its memory is counted under it
+    int width = 0;
+    int height = 0;
+    int tileWidth = 0;
+    int tileHeight = 0;
+    std::size_t collisionLayer = 0; // index into layers of the solid ground layer
+    std::vector<TilesetInfo> tilesets; // sorted by firstGid
+    std::vector<TileLayer> layers;
+
+    // Flat gid indexed property table, entry 0 is the empty tile
+    std::vector<TileProperties> tileProperties;
+
+    // Flat gid indexed, 1 for tiles that are fully opaque and cover at
+    // least their whole cell
+    std::vector<std::uint8_t> tileOpaque;
+
+    // Every animated gid, and a flat gid indexed table of where it is in
+    // there, -1 for tiles that don't animate
+    std::vector<TileAnimation> animations;
+    std::vector<int> tileAnimation;
+
+    // Cells can change after load (TileMap::setTile). Edits and chunk mesh
+    // builds take this lock, the thread making the edits reads without it
+    mutable std::mutex editMutex;
+    std::uint64_t revision = 0;                // bumped by every edit
+    std::vector<std::uint64_t> chunkRevisions; // revision of the last edit in each chunk
+
+    int chunksX() const { return (width + CHUNK_SIZE - 1) / CHUNK_SIZE; }
+    int chunksY() const { return (height + CHUNK_SIZE - 1) / CHUNK_SIZE; }
+
+    // Index of the tileset owning a gid, -1 if there is none
+    int findTileset(std::uint32_t gid) const;
+
+    // Properties of a gid, O(1). Gids no tileset owns read as empty
+    const TileProperties& getProperties(std::uint32_t gid) const;
+
+    // Fills tileProperties, tileOpaque and the animations from the tilesets
+    void buildPropertyTable();
+
+    // Index into animations for a gid, -1 if it doesn't animate
+    int findAnimation(std::uint32_t gid) const {
+        gid &= GID_MASK;
+        return gid < tileAnimation.size() ? tileAnimation[gid] : -1;
+    }
+
+    bool isOpaque(std::uint32_t gid) const {
+        gid &= GID_MASK;
+        return gid < tileOpaque.size() && tileOpaque[gid];
+    }
+
+    // Position of a layer's tiles of one tileset in the draw order. Every
+    // layer's non solid tiles are drawn first (drawBackgroundTiles), then
+    // every layer's solid ones (drawCollisionTiles)
+    std::size_t drawRank(std::size_t layer, int tileset) const {
+        return (tilesets[tileset].solid ? layers.size() : 0) + layer;
+    }
+
+    // True when the cell's tile in layer can't be seen because a tile
+    // drawn later has an opaque tile over it. Only tiles that stay inside
+    // their cell are ever hidden, oversized ones reach past the cover
+    bool isCellHidden(std::size_t layer, int x, int y) const;
+};
+
+// Where a cell's quad sits in a chunk mesh, so one cell can be redrawn
+// without building the whole chunk again
+struct CellQuad {
+    int tileset = -1;       // -1 if the cell never had a quad
+    std::size_t vertex = 0; // first of its six vertices in that tileset's array
+};
+
+// A quad showing an animated tile, its texture coordinates follow the frames
+struct AnimatedQuad {
+    int animation = 0;
+    std::size_t layer = 0;
+    int tileset = 0;
+    std::size_t vertex = 0;
+};
+
+// Render data for one chunk, a vertex array per layer per tileset
+struct ChunkMesh {
+    int chunkX = 0;
+    int chunkY = 0;
+    std::uint64_t revision = 0; // map revision it was built from
+    std::size_t abandonedQuads = 0; // collapsed quads left behind by cells that changed tileset
+    std::vector<std::vector<sf::VertexArray>> layers; // [layer][tileset]
+    std::vector<std::vector<CellQuad>> cells;         // [layer][cell in the chunk, row major]
+    std::vector<AnimatedQuad> animated;
+    MemoryRecord memory;
+};
+
+// Builds the triangles for every tile of a chunk, safe to call off the main
+// thread. Takes the map's edit lock
+ChunkMesh buildChunkMesh(const MapData& map, int chunkX, int chunkY);
+
+// Redoes the quads of every layer at one map cell from the map's current
+// cells, O(layers). A quad that goes away is collapsed to nothing rather
+// than removed so the others keep their order, a cell moving to another
+// tileset leaves its old one behind. Call with the edit lock held
+void updateCellQuads(ChunkMesh& mesh, const MapData& map, int x, int y);
+
+// Points the chunk's animated quads at the frames showing now, frames holds
+// a local tile id per map animation (-1 to leave it). With changed only the
+// animations flagged there are touched
+void animateChunk(ChunkMesh& mesh, const MapData& map, const std::vector<int>& frames, const std::vector<std::uint8_t>* changed = nullptr);
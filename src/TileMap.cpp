@@ -1,216 +1,441 @@
 #include "TileMap.hpp"
+#include "Log.hpp"
 #include "Tile.hpp"
+#include "MapReader.hpp"
+#include "AabbBatch.hpp"
 
 #include <fstream>
-#include <iostream>
 #include "../libs/json.hpp"
 #include <filesystem>
 #include <algorithm>
-#include <set>
+#include <climits>
+#include <cmath>
+#include <limits>
 
 using json = nlohmann::json;
 namespace fs = std::filesystem;
 
 bool TileMap::loadFromFile(const std::string& filePath){
-    std::ifstream file(filePath);
-    if (!file.is_open()){
-        std::cerr << "Failed to open map file: " << filePath << "\n";
+    MapFile mapFile;
+    if (!readMapFile(filePath, mapFile)){
         return false;
     }
 
-    json mapData;
-    try {
-        file >> mapData;
-    } catch (const std::exception& e){
-        std::cerr << "JSON parse error: " << e.what() << "\n";
-        return false;
-    }
+    auto map = std::make_shared<MapData>();
+    map->path = filePath;
+    map->tileWidth = mapFile.tileWidth;
+    map->tileHeight = mapFile.tileHeight;
 
-    // Get map dimensions
-    _width = mapData["width"];
-    _height = mapData["height"];
-    _tileWidth = mapData["tilewidth"];
-    _tileHeight = mapData["tileheight"];
-
-    // Load tilesets and map IDs to tile textures
-    std::map<int, std::shared_ptr<sf::Texture>> tileIdMap;
-    std::map<std::string, int> tilesetNameToGid;
+    // Load tilesets, each one stays a single texture
     std::string mapDirectory = fs::path(filePath).parent_path().string();
 
-    std::cout << "Tilesets array size: " << mapData["tilesets"].size() << "\n";
-
-    for (size_t i = 0; i < mapData["tilesets"].size(); ++i){
-        std::cout << "Processing tileset " << i << "\n";
-        std::cout.flush();
-        
-        const auto& tileset = mapData["tilesets"][i];
-        int firstGid = tileset["firstgid"];
-        std::string tilesetSource = tileset["source"];
-        std::string tilesetPath = mapDirectory + "/" + tilesetSource;
-
-        std::cout << "Loading tileset: " << tilesetSource << " at " << tilesetPath << "\n";
-        std::cout.flush();
-        
-        auto tileMap = loadTileset(tilesetPath, firstGid);
-        std::cout << "Back from loadTileset, got " << tileMap.size() << " tiles\n";
-        std::cout.flush();
-        
-        if (tileMap.empty()){
-            std::cerr << "WARNING: Tileset loaded 0 tiles! Check path.\n";
+    LOG_DEBUG("Tilesets array size: " << mapFile.tilesets.size());
+
+    for (const auto& tilesetRef : mapFile.tilesets){
+        std::string tilesetPath = mapDirectory + "/" + tilesetRef.source;
+
+        LOG_DEBUG("Loading tileset: " << tilesetRef.source << " at " << tilesetPath);
+
+        TilesetInfo info;
+        if (!loadTileset(tilesetPath, tilesetRef.firstGid, filePath, info)){
+            LOG_WARNING("Tileset loaded 0 tiles! Check path.");
             continue;
         }
-        
-        std::cout << "Inserting into tileIdMap...\n";
-        std::cout.flush();
-        
-        for (auto& [id, tex] : tileMap){
-            tileIdMap[id] = tex;
+        LOG_DEBUG("Tileset " << tilesetRef.source << " has " << info.tileCount << " tiles");
+        map->tilesets.push_back(std::move(info));
+    }
+    std::sort(map->tilesets.begin(), map->tilesets.end(),
+              [](const TilesetInfo& a, const TilesetInfo& b){ return a.firstGid < b.firstGid; });
+
+    map->buildPropertyTable();
+
+    LOG_DEBUG("Finished loading all tilesets");
+
+    // Load tile layer data
+    std::vector<MapLayerSource*> tileLayers;
+    for (auto& layer : mapFile.layers){
+        if (layer.type == "tilelayer") tileLayers.push_back(&layer);
+    }
+    if (tileLayers.empty()){
+        LOG_ERROR("No tile layers found in map");
+        return false;
+    }
+
+    LOG_DEBUG("Number of layers: " << tileLayers.size());
+
+    int originX = 0;
+    int originY = 0;
+    if (mapFile.infinite){
+        // Infinite maps only store the chunks that were painted, so the grid
+        // covers their union and Tiled's origin moves to its top left
+        int minX = INT_MAX, minY = INT_MAX, maxX = INT_MIN, maxY = INT_MIN;
+        for (const MapLayerSource* layer : tileLayers){
+            for (const auto& chunk : layer->chunks){
+                minX = std::min(minX, chunk.x);
+                minY = std::min(minY, chunk.y);
+                maxX = std::max(maxX, chunk.x + chunk.width);
+                maxY = std::max(maxY, chunk.y + chunk.height);
+            }
+        }
+        if (minX > maxX){
+            LOG_ERROR("Infinite map has no chunks");
+            return false;
         }
-        
-        std::cout << "Insert complete\n";
-        std::cout.flush();
-        
-        tilesetNameToGid[tilesetSource] = firstGid;
-        
-        std::cout << "Tileset " << tilesetSource << " has " << tileMap.size() << " tiles\n";
-        
-        // Check if this is a collision tileset
-        if (tilesetSource.find("Village.json") != std::string::npos){
-            _collisionTilesetGids.insert(firstGid);
-            std::cout << "  -> Marked as collision tileset (gid: " << firstGid << ")\n";
+        originX = minX;
+        originY = minY;
+        map->width = maxX - minX;
+        map->height = maxY - minY;
+    } else {
+        map->width = mapFile.width;
+        map->height = mapFile.height;
+    }
+
+    std::size_t cellCount = (std::size_t)map->width * map->height;
+    for (MapLayerSource* layer : tileLayers){
+        TileLayer tileLayer;
+        tileLayer.name = layer->name;
+        tileLayer.id = layer->id;
+        LOG_DEBUG("Processing layer " << tileLayer.name);
+
+        if (mapFile.infinite){
+            tileLayer.data.assign(cellCount, 0);
+            for (const auto& chunk : layer->chunks){
+                int cx = chunk.x - originX;
+                int cy = chunk.y - originY;
+                for (std::size_t i = 0; i < chunk.data.size(); ++i){
+                    int x = cx + (int)i % chunk.width;
+                    int y = cy + (int)i / chunk.width;
+                    tileLayer.data[y * map->width + x] = chunk.data[i];
+                }
+            }
         } else {
-            std::cout << "  -> Marked as background tileset\n";
+            // The parser already wrote the cells in grid order
+            tileLayer.data = std::move(layer->data);
+            tileLayer.data.resize(cellCount, 0);
         }
-        std::cout.flush();
+        map->layers.push_back(std::move(tileLayer));
     }
-    
-    std::cout << "Finished loading all tilesets\n";
-    std::cout << "Total collision tilesets: " << _collisionTilesetGids.size() << "\n";
-    std::cout.flush();
 
-    // Load tile layer data
-    if (mapData["layers"].empty()){
-        std::cerr << "No tile layers found in map\n";
-        return false;
+    // The first tile layer ("Tile Layer 1") holds the ground, its tiles
+    // from solid tilesets are what collision sees
+    map->collisionLayer = 0;
+
+    _map = map;
+    _mapPath = filePath;
+    _originX = originX;
+    _originY = originY;
+    loadObjects(mapFile);
+    loadImageLayers(mapFile, mapDirectory);
+    computeOverdrawStats();
+
+    std::size_t chunkCount = (std::size_t)_map->chunksX() * _map->chunksY();
+    _map->chunkRevisions.assign(chunkCount, 0);
+    countMapMemory();
+    _tileFrames.assign(_map->animations.size(), -1); // set on the first updateAnimations
+    _chunkMeshes.clear();
+    _chunkMeshes.resize(chunkCount);
+    _chunkPending.assign(chunkCount, false);
+    _residentChunks.clear();
+    _editedCells.clear();
+    _drawX0 = _drawY0 = 0;
+    _drawX1 = _drawY1 = -1;
+
+    // The shader draws straight from the grid, chunk meshes are only
+    // streamed when it can't be used
+    if (_preferShader && _shaderTiles.build(*_map)){
+        LOG_INFO("Drawing tile layers with the tile shader");
+        _streamer.reset();
+    } else {
+        _streamer = std::make_unique<ChunkStreamer>(_map);
     }
 
-    std::cout << "Number of layers: " << mapData["layers"].size() << "\n";
-
-    // Process all layers
-    for (size_t layerIdx = 0; layerIdx < mapData["layers"].size(); ++layerIdx){
-        const auto& layer = mapData["layers"][layerIdx];
-        std::string layerName = layer["name"];
-        std::cout << "Processing layer " << layerIdx << ": " << layerName << "\n";
-
-        const std::vector<int>& tileData = layer["data"];
-        int layerId = layer["id"];
-
-        // Create tiles from data
-        for (int y = 0; y < _height; ++y){
-            for (int x = 0; x < _width; ++x){
-                int index = y * _width + x;
-                int tileId = tileData[index];
-
-                // 0 means empty tile
-                if (tileId == 0) continue;
-
-                // Find the texture for this ID
-                if (tileIdMap.find(tileId) != tileIdMap.end()){
-                    float xPos = x * _tileWidth;
-                    float yPos = y * _tileHeight;
-
-                    TileInfo tile = {
-                        tileIdMap[tileId],
-                        {xPos, yPos},
-                        layerId
-                    };
-
-                    // Determine which tileset this tile belongs to
-                    int tilesetGid = 0;
-                    for (int gid : _collisionTilesetGids){
-                        if (tileId >= gid) tilesetGid = gid;
-                    }
-
-                    // Separate collision and background tiles
-                    if (_collisionTilesetGids.count(tilesetGid)){
-                        _collisionTiles.push_back(tile);
-                    } else {
-                        _backgroundTiles.push_back(tile);
-                    }
+    LOG_INFO("Loaded tilemap: " << _map->width << "x" << _map->height
+             << " | Layers: " << _map->layers.size()
+             << " | Chunks: " << _map->chunksX() << "x" << _map->chunksY());
+    return true;
+}
+
+void TileMap::loadObjects(const MapFile& mapFile){
+    // Objects are in Tiled's pixels, shift them by the same amount as the tiles
+    float offsetX = (float)(-_originX * _map->tileWidth);
+    float offsetY = (float)(-_originY * _map->tileHeight);
+
+    std::vector<TriggerVolume> volumes;
+    _hasSpawn = false;
+
+    for (const auto& layer : mapFile.layers){
+        if (layer.type != "objectgroup") continue;
+
+        for (const auto& object : layer.objects){
+            float x = object.x + offsetX;
+            float y = object.y + offsetY;
+            if (object.gid != 0) y -= object.height; // tile objects hang from their bottom edge
+
+            if (object.type == "spawn"){
+                _spawn = {x, y};
+                _hasSpawn = true;
+                continue;
+            }
+
+            TriggerVolume volume;
+            volume.id = object.id;
+            volume.name = object.name;
+            volume.kind = triggerKindFromString(object.type);
+            volume.bounds = sf::FloatRect({x, y}, {object.width, object.height});
+            for (const auto& property : object.properties){
+                if (property.name == "damage") volume.damage = (int)property.number;
+            }
+            volumes.push_back(std::move(volume));
+        }
+    }
+
+    LOG_INFO("Loaded " << volumes.size() << " trigger volumes"
+             << (_hasSpawn ? " and a spawn point" : ", no spawn point"));
+    _triggers.build(std::move(volumes), (float)(TRIGGER_BUCKET_TILES * _map->tileWidth));
+}
+
+void TileMap::computeOverdrawStats(){
+    _overdraw = OverdrawStats();
+
+    for (std::size_t layer = 0; layer < _map->layers.size(); ++layer){
+        const auto& data = _map->layers[layer].data;
+        for (int y = 0; y < _map->height; ++y){
+            for (int x = 0; x < _map->width; ++x){
+                std::uint32_t gid = data[(std::size_t)y * _map->width + x] & GID_MASK;
+                int tilesetIdx = _map->findTileset(gid);
+                if (tilesetIdx < 0) continue;
+
+                const TilesetInfo& tileset = _map->tilesets[tilesetIdx];
+                std::size_t pixels = (std::size_t)tileset.tileWidth * tileset.tileHeight;
+                if (_map->isCellHidden(layer, x, y)){
+                    _overdraw.hiddenCells++;
+                    _overdraw.pixelsSaved += pixels;
+                }
+                else {
+                    _overdraw.drawnCells++;
+                    _overdraw.pixelsDrawn += pixels;
                 }
             }
         }
     }
 
-    // Store only the collision layer's tile data for collision queries
-    if (!mapData["layers"].empty()){
-        const auto& layer = mapData["layers"][0];
-        _tileData = layer["data"].get<std::vector<int>>();
+    std::size_t totalPixels = _overdraw.pixelsSaved + _overdraw.pixelsDrawn;
+    LOG_INFO("Overdraw: " << _overdraw.hiddenCells << " hidden cells dropped, "
+             << _overdraw.pixelsSaved << " of " << totalPixels << " tile px saved per full redraw ("
+             << (totalPixels ? 100.0 * _overdraw.pixelsSaved / totalPixels : 0.0) << "%)");
+}
+
+void TileMap::loadImageLayers(const MapFile& mapFile, const std::string& mapDirectory){
+    _background.clear();
+
+    for (const auto& layer : mapFile.layers){
+        if (layer.type != "imagelayer" || layer.image.empty()) continue;
+
+        std::string imagePath = layer.image;
+        std::replace(imagePath.begin(), imagePath.end(), '\\', '/');
+        std::string fullImagePath = mapDirectory + "/" + imagePath;
+
+        auto& texture = _textureCache[fullImagePath];
+        if (!texture){
+            texture = ResourceMemory::makeTexture();
+            if (!texture->loadFromFile(fullImagePath)){
+                LOG_ERROR("Failed to load image layer " << layer.name << ": " << fullImagePath);
+                _textureCache.erase(fullImagePath);
+                continue;
+            }
+            ResourceMemory::trackTexture(texture, _mapPath, "Backgrounds", fullImagePath);
+        }
+
+        ParallaxLayer parallaxLayer;
+        parallaxLayer.texture = texture;
+        parallaxLayer.offset = {layer.offsetX - _originX * _map->tileWidth, layer.offsetY - _originY * _map->tileHeight};
+        parallaxLayer.parallax = {layer.parallaxX, layer.parallaxY};
+        parallaxLayer.repeatX = layer.repeatX;
+        parallaxLayer.repeatY = layer.repeatY;
+        parallaxLayer.tint.a = static_cast<std::uint8_t>(255.f * std::clamp(layer.opacity, 0.f, 1.f));
+        // Tiled can't scale image layers, small pixel art sets a "scale" property
+        for (const auto& property : layer.properties){
+            if (property.name == "scale") parallaxLayer.scale = (float)property.number;
+        }
+        _background.addLayer(std::move(parallaxLayer));
     }
+}
 
-    std::cout << "Loaded tilemap: " << _width << "x" << _height 
-              << " | Collision: " << _collisionTiles.size() 
-              << " | Background: " << _backgroundTiles.size() << "\n";
+void TileMap::countMapMemory(){
+    std::size_t bytes = _map->tileProperties.size() * sizeof(TileProperties) + _map->tileOpaque.size() +
+                        _map->tileAnimation.size() * sizeof(int) + _map->chunkRevisions.size() * sizeof(std::uint64_t);
+    for (const auto& layer : _map->layers){
+        bytes += layer.data.size() * sizeof(std::uint32_t);
+    }
+    sf::Vector2u size = {(unsigned)((std::size_t)_map->width * _map->height), (unsigned)_map->layers.size()};
+    _mapMemory = MemoryRecord({ResourceKind::DATA, _mapPath, "Map data", _mapPath, size, bytes});
+}
+
+bool TileMap::getSpawnPoint(sf::Vector2f& spawn) const{
+    if (!_hasSpawn) return false;
+    spawn = _spawn;
     return true;
 }
 
-void TileMap::drawCollisionTiles(sf::RenderWindow& window) const{
-    for (const auto& tileInfo : _collisionTiles){
-        sf::Sprite sprite(*tileInfo.texture);
-        sprite.setPosition(tileInfo.position);
-        window.draw(sprite);
+void TileMap::storeChunk(ChunkMesh&& mesh){
+    int index = mesh.chunkY * _map->chunksX() + mesh.chunkX;
+    _chunkPending[index] = false;
+    if (_chunkMeshes[index]) return; // already built on the main thread
+
+    // Cells changed while the streaming thread had it, build it again
+    bool stale;
+    {
+        std::lock_guard<std::mutex> lock(_map->editMutex);
+        stale = mesh.revision < _map->chunkRevisions[index];
     }
+    if (stale) mesh = buildChunkMesh(*_map, mesh.chunkX, mesh.chunkY);
+    animateChunk(mesh, *_map, _tileFrames);
+    _chunkMeshes[index] = std::make_unique<ChunkMesh>(std::move(mesh));
+    _residentChunks.push_back(index);
 }
 
-void TileMap::drawBackgroundTiles(sf::RenderWindow& window) const{
-    for (const auto& tileInfo : _backgroundTiles){
-        sf::Sprite sprite(*tileInfo.texture);
-        sprite.setPosition(tileInfo.position);
-        window.draw(sprite);
+void TileMap::updateStreaming(const sf::View& view){
+    applyEdits();
+    if (!_streamer) return;
+
+    int chunksX = _map->chunksX();
+    int chunksY = _map->chunksY();
+    float chunkW = (float)(CHUNK_SIZE * _map->tileWidth);
+    float chunkH = (float)(CHUNK_SIZE * _map->tileHeight);
+
+    sf::Vector2f topLeft = view.getCenter() - view.getSize() / 2.f;
+    sf::Vector2f bottomRight = view.getCenter() + view.getSize() / 2.f;
+    int viewX0 = (int)std::floor(topLeft.x / chunkW);
+    int viewY0 = (int)std::floor(topLeft.y / chunkH);
+    int viewX1 = (int)std::floor(bottomRight.x / chunkW);
+    int viewY1 = (int)std::floor(bottomRight.y / chunkH);
+
+    _drawX0 = std::max(0, viewX0);
+    _drawY0 = std::max(0, viewY0);
+    _drawX1 = std::min(chunksX - 1, viewX1);
+    _drawY1 = std::min(chunksY - 1, viewY1);
+
+    // Pick up whatever the streaming thread finished
+    for (auto& mesh : _streamer->collect()){
+        storeChunk(std::move(mesh));
+    }
+
+    // Chunks on screen have to be there this frame
+    for (int cy = _drawY0; cy <= _drawY1; ++cy){
+        for (int cx = _drawX0; cx <= _drawX1; ++cx){
+            if (!_chunkMeshes[cy * chunksX + cx]){
+                storeChunk(buildChunkMesh(*_map, cx, cy));
+            }
+        }
+    }
+
+    // Prefetch the ring around the view
+    int preX0 = std::max(0, viewX0 - STREAM_MARGIN);
+    int preY0 = std::max(0, viewY0 - STREAM_MARGIN);
+    int preX1 = std::min(chunksX - 1, viewX1 + STREAM_MARGIN);
+    int preY1 = std::min(chunksY - 1, viewY1 + STREAM_MARGIN);
+    for (int cy = preY0; cy <= preY1; ++cy){
+        for (int cx = preX0; cx <= preX1; ++cx){
+            int index = cy * chunksX + cx;
+            if (!_chunkMeshes[index] && !_chunkPending[index]){
+                _chunkPending[index] = true;
+                _streamer->request(cx, cy);
+            }
+        }
+    }
+
+    // Drop render data that is well out of view, collision data stays
+    for (std::size_t i = 0; i < _residentChunks.size();){
+        int index = _residentChunks[i];
+        int cx = index % chunksX;
+        int cy = index / chunksX;
+        if (cx < viewX0 - EVICT_MARGIN || cx > viewX1 + EVICT_MARGIN ||
+            cy < viewY0 - EVICT_MARGIN || cy > viewY1 + EVICT_MARGIN){
+            _chunkMeshes[index].reset();
+            _residentChunks[i] = _residentChunks.back();
+            _residentChunks.pop_back();
+        } else {
+            ++i;
+        }
     }
 }
 
-sf::FloatRect TileMap::getTileCollisionBounds(int mapX, int mapY) const{
-    if (mapX < 0 || mapX >= _width || mapY < 0 || mapY >= _height){
-        return sf::FloatRect(sf::Vector2f(0, 0), sf::Vector2f(0, 0)); // Out of bounds
+void TileMap::drawLayer(sf::RenderTarget& target, std::size_t layer, bool solid) const{
+    if (_shaderTiles.isReady()){
+        _shaderTiles.drawLayer(target, layer, solid);
+        return;
     }
-    
-    int index = mapY * _width + mapX;
-    if (index >= (int)_tileData.size() || _tileData[index] == 0){
-        return sf::FloatRect(sf::Vector2f(0, 0), sf::Vector2f(0, 0)); // No tile
+
+    int chunksX = _map->chunksX();
+    for (int cy = _drawY0; cy <= _drawY1; ++cy){
+        for (int cx = _drawX0; cx <= _drawX1; ++cx){
+            const auto& mesh = _chunkMeshes[cy * chunksX + cx];
+            if (!mesh) continue;
+
+            const auto& arrays = mesh->layers[layer];
+            for (std::size_t t = 0; t < arrays.size(); ++t){
+                if (arrays[t].getVertexCount() == 0 || _map->tilesets[t].solid != solid) continue;
+                target.draw(arrays[t], sf::RenderStates(_map->tilesets[t].texture.get()));
+            }
+        }
     }
+}
 
-    int tileId = _tileData[index];
-    
-    // Find which tileset this tile belongs to
-    int tilesetGid = 0;
-    for (int gid : _collisionTilesetGids){
-        if (tileId >= gid) tilesetGid = gid;
+void TileMap::drawCollisionTiles(sf::RenderTarget& target) const{
+    for (std::size_t layer = 0; layer < _map->layers.size(); ++layer){
+        drawLayer(target, layer, true);
     }
-    
-    // Only return collision bounds if this is a collision tile
-    if (!_collisionTilesetGids.count(tilesetGid)){
-        return sf::FloatRect(sf::Vector2f(0, 0), sf::Vector2f(0, 0)); // Background tile, no collision
+}
+
+void TileMap::drawBackgroundTiles(sf::RenderTarget& target) const{
+    for (std::size_t layer = 0; layer < _map->layers.size(); ++layer){
+        drawLayer(target, layer, false);
     }
+}
 
-    float x = mapX * _tileWidth;
-    float y = mapY * _tileHeight;
-    return sf::FloatRect(sf::Vector2f(x, y), sf::Vector2f(_tileWidth, _tileHeight));
+// Marks the tiles whose every pixel is fully opaque, reading the atlas rows
+// directly. Tiles hanging off the edge of the image count as see through
+static void classifyOpaqueTiles(const sf::Image& image, TilesetInfo& tileset){
+    tileset.opaqueTiles.assign(tileset.tileCount, 0);
+    if (tileset.columns <= 0) return;
+
+    sf::Vector2u size = image.getSize();
+    const std::uint8_t* pixels = image.getPixelsPtr();
+    if (!pixels) return;
+
+    for (int local = 0; local < tileset.tileCount; ++local){
+        unsigned left = (unsigned)((local % tileset.columns) * tileset.tileWidth);
+        unsigned top = (unsigned)((local / tileset.columns) * tileset.tileHeight);
+        if (left + tileset.tileWidth > size.x || top + tileset.tileHeight > size.y) continue;
+
+        bool opaque = true;
+        for (int y = 0; y < tileset.tileHeight && opaque; ++y){
+            const std::uint8_t* row = pixels + ((std::size_t)(top + y) * size.x + left) * 4;
+            for (int x = 0; x < tileset.tileWidth; ++x){
+                if (row[x * 4 + 3] != 255){
+                    opaque = false;
+                    break;
+                }
+            }
+        }
+        tileset.opaqueTiles[local] = opaque ? 1 : 0;
+    }
 }
 
-std::map<int, std::shared_ptr<sf::Texture>> TileMap::loadTileset(const std::string& tilesetPath, int firstGid){std::map<int, std::shared_ptr<sf::Texture>> tileMap; std::ifstream file(tilesetPath);
+bool TileMap::loadTileset(const std::string& tilesetPath, int firstGid, const std::string& mapPath, TilesetInfo& tileset){
+    std::ifstream file(tilesetPath);
 
     if (!file.is_open()){
-        std::cerr << "Failed to open tileset: " << tilesetPath << "\n";
-        return tileMap;
+        LOG_ERROR("Failed to open tileset: " << tilesetPath);
+        return false;
     }
 
     json tilesetData;
     try {
         file >> tilesetData;
     } catch (const std::exception& e){
-        std::cerr << "JSON parse error in tileset: " << e.what() << "\n";
-        return tileMap;
+        LOG_ERROR("JSON parse error in tileset: " << e.what());
+        return false;
     }
 
     // Get tileset info
@@ -220,7 +445,7 @@ std::map<int, std::shared_ptr<sf::Texture>> TileMap::loadTileset(const std::stri
     int columns = tilesetData["columns"];
     std::string tilesetName = tilesetData["name"];
 
-    std::cout << "Tileset JSON loaded: " << tilesetName << "\n";
+    LOG_DEBUG("Tileset JSON loaded: " << tilesetName);
 
     // Replace backslashes with forward slashes
     std::replace(imagePath.begin(), imagePath.end(), '\\', '/');
@@ -229,94 +454,389 @@ std::map<int, std::shared_ptr<sf::Texture>> TileMap::loadTileset(const std::stri
     std::string tilesetDir = fs::path(tilesetPath).parent_path().string();
     std::string fullImagePath = tilesetDir + "/" + imagePath;
 
-    std::cout << "Looking for image at: " << fullImagePath << "\n";
-
-    // Load the tileset image
-    auto fullTexture = std::make_shared<sf::Texture>();
-    if (!fullTexture->loadFromFile(fullImagePath)){
-        std::cerr << "Failed to load tileset image: " << fullImagePath << "\n";
-        return tileMap;
+    // Decode the tileset image once, the pixels are needed here to find the
+    // opaque tiles and the texture is uploaded from the same copy
+    sf::Image image;
+    if (!image.loadFromFile(fullImagePath)){
+        LOG_ERROR("Failed to load tileset image: " << fullImagePath);
+        return false;
+    }
+    MemoryRecord decoded({ResourceKind::IMAGE, mapPath, "Tilesets", fullImagePath, image.getSize(),
+                          ResourceMemory::textureBytes(image.getSize())});
+
+    // Tiles are drawn straight out of one texture per image
+    auto& texture = _textureCache[fullImagePath];
+    if (!texture){
+        texture = ResourceMemory::makeTexture();
+        if (!texture->loadFromImage(image)){
+            LOG_ERROR("Failed to create tileset texture: " << fullImagePath);
+            _textureCache.erase(fullImagePath);
+            return false;
+        }
+        ResourceMemory::trackTexture(texture, mapPath, "Tilesets", fullImagePath);
     }
 
-    std::cout << "Image loaded successfully\n";
-
-    // Extract individual tiles
     int imageWidth = tilesetData["imagewidth"];
     int imageHeight = tilesetData["imageheight"];
-    int tilesPerRow = columns;
-    int totalTiles = (imageWidth / tileWidth) * (imageHeight / tileHeight);
 
-    for (int tileId = 0; tileId < totalTiles; ++tileId){
-        auto tilTexture = extractTile(*fullTexture, tileId, tilesPerRow, tileWidth, tileHeight);
-        tileMap[tileId + firstGid] = tilTexture;
+    tileset.source = fs::path(tilesetPath).filename().string();
+    tileset.path = tilesetPath;
+    tileset.imagePath = fullImagePath;
+    tileset.firstGid = firstGid;
+    tileset.tileCount = (imageWidth / tileWidth) * (imageHeight / tileHeight);
+    tileset.columns = columns;
+    tileset.tileWidth = tileWidth;
+    tileset.tileHeight = tileHeight;
+    tileset.texture = texture;
+    classifyOpaqueTiles(image, tileset);
+
+    // Tileset wide properties, "solid" marks the ground tilesets
+    for (const auto& property : tilesetData.value("properties", json::array())){
+        if (property["name"] == "solid") tileset.solid = property["value"].get<bool>();
+    }
+
+    // Per tile behaviour, set in Tiled as the tile's class or custom properties
+    for (const auto& tile : tilesetData.value("tiles", json::array())){
+        TileProperties properties;
+        if (tile.contains("type")) properties.type = tileTypeFromString(tile["type"]);
+        if (tile.contains("class")) properties.type = tileTypeFromString(tile["class"]);
+
+        for (const auto& property : tile.value("properties", json::array())){
+            std::string name = property["name"];
+            const auto& value = property["value"];
+            if (name == "type") properties.type = tileTypeFromString(value);
+            else if (name == "friction") properties.friction = value.get<float>();
+            else if (name == "bounce") properties.bounce = value.get<float>();
+            else if (name == "damage") properties.damage = value.get<int>();
+        }
+        tileset.tileProperties.push_back({tile["id"].get<int>(), properties});
+
+        // Tiled tile animation, a list of tile ids and how long each shows
+        std::vector<TileFrame> frames;
+        for (const auto& frame : tile.value("animation", json::array())){
+            frames.push_back({frame["tileid"].get<int>(), frame["duration"].get<int>()});
+        }
+        if (!frames.empty()) tileset.tileAnimations.push_back({tile["id"].get<int>(), std::move(frames)});
     }
 
-    std::cout << "Loaded tileset: " << tilesetName << " with " << totalTiles << " tiles\n";
-    return tileMap;
+    LOG_INFO("Loaded tileset: " << tilesetName << " with " << tileset.tileCount << " tiles");
+    return tileset.tileCount > 0;
 }
 
-std::shared_ptr<sf::Texture> TileMap::extractTile(const sf::Texture& tilesetTexture, int tileId, int columns, int tileWidth, int tileHeight){
-    // Convert the texture into an image
-    sf::Image tilesetImage = tilesetTexture.copyToImage();
+void TileMap::releaseResources(ReleaseQueue& queue){
+    // Stop streaming first so nothing is still reading the map
+    _streamer.reset();
 
-    int row = tileId / columns;
-    int col = tileId % columns;
+    for (auto& mesh : _chunkMeshes){
+        queue.defer(std::move(mesh));
+    }
+    for (auto& tileset : _map->tilesets){
+        queue.defer(std::move(tileset.texture));
+    }
+    for (auto& [path, texture] : _textureCache){
+        queue.defer(std::move(texture));
+    }
+
+    _shaderTiles.release(queue);
+
+    _map = std::make_shared<MapData>();
+    _mapMemory = MemoryRecord();
+    _mapPath.clear();
+    _originX = _originY = 0;
+    _triggers.build({}, 1.f);
+    _hasSpawn = false;
+    _background.clear();
+    _chunkMeshes.clear();
+    _chunkPending.clear();
+    _residentChunks.clear();
+    _editedCells.clear();
+    _tileFrames.clear();
+    _textureCache.clear();
+    _drawX0 = _drawY0 = 0;
+    _drawX1 = _drawY1 = -1;
+}
 
-    int x = col * tileWidth;
-    int y = row * tileHeight;
+bool TileMap::setTile(std::size_t layer, int x, int y, std::uint32_t gid){
+    if (layer >= _map->layers.size() || x < 0 || x >= _map->width || y < 0 || y >= _map->height) return false;
+    if ((gid & GID_MASK) != 0 && _map->findTileset(gid) < 0) return false;
 
-    // Create an empty image for this tile
-    sf::Image tileImage;
-    tileImage.resize({static_cast<unsigned>(tileWidth), static_cast<unsigned>(tileHeight)}, sf::Color::Transparent);
+    std::lock_guard<std::mutex> lock(_map->editMutex);
+    std::uint32_t& cell = _map->layers[layer].data[(std::size_t)y * _map->width + x];
+    if (cell == gid) return true;
+    cell = gid;
+    _map->chunkRevisions[(y / CHUNK_SIZE) * _map->chunksX() + x / CHUNK_SIZE] = ++_map->revision;
+    _editedCells.push_back({x, y});
+    return true;
+}
 
-    // Copy the pixels from the tileset to the tile
-    for (int ty = 0; ty < tileHeight; ++ty){
-        for (int tx = 0; tx < tileWidth; ++tx){
-            sf::Color pixel = tilesetImage.getPixel({static_cast<unsigned>(x + tx), static_cast<unsigned>(y + ty)});
-            tileImage.setPixel({static_cast<unsigned>(tx), static_cast<unsigned>(ty)}, pixel);
+void TileMap::applyEdits(){
+    std::vector<int> rebuild;
+    {
+        std::lock_guard<std::mutex> lock(_map->editMutex);
+        int chunksX = _map->chunksX();
+        for (const auto& cell : _editedCells){
+            // chunks without render data pick the change up when they're built
+            int index = (cell.y / CHUNK_SIZE) * chunksX + cell.x / CHUNK_SIZE;
+            auto& mesh = _chunkMeshes[index];
+            if (mesh){
+                updateCellQuads(*mesh, *_map, cell.x, cell.y);
+                animateChunk(*mesh, *_map, _tileFrames);
+                if (mesh->abandonedQuads >= CHUNK_SIZE * CHUNK_SIZE) rebuild.push_back(index);
+            }
+            _shaderTiles.updateCell(cell.x, cell.y);
         }
+        _editedCells.clear();
     }
 
-    // Convert the tile image back into a texture
-    auto tileTexture = std::make_shared<sf::Texture>();
-    if (!tileTexture->loadFromImage(tileImage)){
-        std::cerr << "Failed to load tile texture for tileId " << tileId << "\n";
+    // Cells swapping tilesets back and forth leave dead quads behind, a
+    // chunk's worth of them is worth a rebuild
+    for (int index : rebuild){
+        auto& mesh = _chunkMeshes[index];
+        if (mesh->abandonedQuads < CHUNK_SIZE * CHUNK_SIZE) continue;
+        *mesh = buildChunkMesh(*_map, mesh->chunkX, mesh->chunkY);
+        animateChunk(*mesh, *_map, _tileFrames);
+    }
+}
+
+void TileMap::updateAnimations(float dt){
+    const auto& animations = _map->animations;
+    if (animations.empty()) return;
+
+    _animationTime += sf::seconds(dt);
+    std::int64_t time = _animationTime.asMicroseconds() / 1000;
+    _framesChanged.assign(animations.size(), 0);
+    bool anyChanged = false;
+    for (std::size_t i = 0; i < animations.size(); ++i){
+        int frame = animations[i].frameAt(time);
+        if (frame == _tileFrames[i]) continue;
+        _tileFrames[i] = frame;
+        _framesChanged[i] = 1;
+        anyChanged = true;
     }
+    if (!anyChanged) return;
 
-    return tileTexture;
+    // Chunks streamed in later get the current frames when they're stored
+    for (int index : _residentChunks){
+        animateChunk(*_chunkMeshes[index], *_map, _tileFrames, &_framesChanged);
+    }
+    _shaderTiles.setAnimationFrames(_tileFrames);
 }
 
-Tile TileMap::getCollidedTile(const sf::FloatRect& bounds) const {
+bool TileMap::reloadFile(const std::string& path){
+    if (_mapPath.empty()) return false;
+
+    std::error_code error;
+    fs::path changed = fs::weakly_canonical(path, error);
+    auto isChanged = [&](const std::string& other){
+        return !other.empty() && fs::weakly_canonical(other, error) == changed;
+    };
+
+    if (isChanged(_mapPath)) return reloadMap();
+    for (const auto& tileset : _map->tilesets){
+        if (isChanged(tileset.path)) return reloadMap();
+        if (isChanged(tileset.imagePath)) return reloadTilesetImage(tileset.imagePath);
+    }
+    // image layers
+    for (auto& [imagePath, texture] : _textureCache){
+        if (!isChanged(imagePath)) continue;
+        if (!texture->loadFromFile(imagePath)) return false;
+        ResourceMemory::trackTexture(texture, _mapPath, "Backgrounds", imagePath);
+        LOG_INFO("Reloaded " << imagePath);
+        return true;
+    }
+    return false;
+}
+
+// Loads the map again next to this one and keeps the render data of every
+// chunk whose cells came out the same. A broken edit leaves the map as it was
+bool TileMap::reloadMap(){
+    TileMap fresh;
+    fresh._textureCache = _textureCache; // same images, same textures
+    fresh._preferShader = _preferShader;
+    if (!fresh.loadFromFile(_mapPath)){
+        LOG_WARNING("Reload of " << _mapPath << " failed, keeping the old map");
+        return false;
+    }
+
+    const MapData& oldMap = *_map;
+    const MapData& newMap = *fresh._map;
+    bool sameLayout = oldMap.width == newMap.width && oldMap.height == newMap.height &&
+                      oldMap.layers.size() == newMap.layers.size() &&
+                      oldMap.tilesets.size() == newMap.tilesets.size() &&
+                      oldMap.tileOpaque == newMap.tileOpaque &&
+                      oldMap.tileAnimation == newMap.tileAnimation &&
+                      _originX == fresh._originX && _originY == fresh._originY;
+    for (std::size_t t = 0; sameLayout && t < oldMap.tilesets.size(); ++t){
+        const TilesetInfo& a = oldMap.tilesets[t];
+        const TilesetInfo& b = newMap.tilesets[t];
+        sameLayout = a.firstGid == b.firstGid && a.columns == b.columns && a.texture == b.texture &&
+                     a.tileWidth == b.tileWidth && a.tileHeight == b.tileHeight;
+    }
+
+    // Chunks with no changed cell in any layer keep their meshes, the rest
+    // get built again by the streaming
+    std::size_t kept = 0;
+    std::size_t chunkCount = fresh._chunkMeshes.size();
+    if (sameLayout){
+        _streamer.reset(); // nothing may still be building from the old map
+        for (int cy = 0; cy < newMap.chunksY(); ++cy){
+            for (int cx = 0; cx < newMap.chunksX(); ++cx){
+                int index = cy * newMap.chunksX() + cx;
+                if (!_chunkMeshes[index] || chunkChanged(oldMap, newMap, cx, cy)) continue;
+                fresh._chunkMeshes[index] = std::move(_chunkMeshes[index]);
+                fresh._residentChunks.push_back(index);
+                ++kept;
+            }
+        }
+    }
+    LOG_INFO("Reloaded " << _mapPath << ": " << (chunkCount - kept) << " of " << chunkCount << " chunks to rebuild");
+
+    *this = std::move(fresh);
+    return true;
+}
+
+bool TileMap::chunkChanged(const MapData& a, const MapData& b, int chunkX, int chunkY){
+    int startX = chunkX * CHUNK_SIZE;
+    int startY = chunkY * CHUNK_SIZE;
+    int endX = std::min(startX + CHUNK_SIZE, a.width);
+    int endY = std::min(startY + CHUNK_SIZE, a.height);
+    for (std::size_t layer = 0; layer < a.layers.size(); ++layer){
+        for (int y = startY; y < endY; ++y){
+            const std::uint32_t* rowA = &a.layers[layer].data[(std::size_t)y * a.width];
+            const std::uint32_t* rowB = &b.layers[layer].data[(std::size_t)y * b.width];
+            if (!std::equal(rowA + startX, rowA + endX, rowB + startX)) return true;
+        }
+    }
+    return false;
+}
+
+// Uploads only the tiles whose pixels changed into the texture the chunk
+// meshes already use. If that changes which tiles are opaque the map is
+// reloaded too, since hidden cells depend on it
+bool TileMap::reloadTilesetImage(const std::string& imagePath){
+    sf::Image image;
+    if (!image.loadFromFile(imagePath)){
+        LOG_WARNING("Reload of " << imagePath << " failed, keeping the old image");
+        return false;
+    }
+    MemoryRecord decoded({ResourceKind::IMAGE, _mapPath, "Tilesets", imagePath, image.getSize(),
+                          ResourceMemory::textureBytes(image.getSize())});
+
+    for (const auto& tileset : _map->tilesets){
+        if (tileset.imagePath != imagePath) continue;
+        sf::Texture& texture = *tileset.texture;
+
+        if (texture.getSize() != image.getSize()){
+            if (!texture.loadFromImage(image)) return false;
+            ResourceMemory::trackTexture(tileset.texture, _mapPath, "Tilesets", imagePath);
+            LOG_INFO("Reloaded " << imagePath << " at its new size");
+            return reloadMap();
+        }
+
+        sf::Image old = texture.copyToImage();
+        MemoryRecord oldCopy({ResourceKind::IMAGE, _mapPath, "Tilesets", imagePath + " (old pixels)", old.getSize(),
+                              ResourceMemory::textureBytes(old.getSize())});
+        std::vector<std::uint8_t> tilePixels((std::size_t)tileset.tileWidth * tileset.tileHeight * 4);
+        std::size_t rowBytes = (std::size_t)tileset.tileWidth * 4;
+        sf::Vector2u size = image.getSize();
+        int changedTiles = 0;
+        for (int local = 0; local < tileset.tileCount; ++local){
+            unsigned left = (unsigned)((local % tileset.columns) * tileset.tileWidth);
+            unsigned top = (unsigned)((local / tileset.columns) * tileset.tileHeight);
+            if (left + tileset.tileWidth > size.x || top + tileset.tileHeight > size.y) continue;
+
+            bool changed = false;
+            for (int y = 0; y < tileset.tileHeight; ++y){
+                std::size_t offset = ((std::size_t)(top + y) * size.x + left) * 4;
+                const std::uint8_t* row = image.getPixelsPtr() + offset;
+                if (!std::equal(row, row + rowBytes, old.getPixelsPtr() + offset)) changed = true;
+                std::copy(row, row + rowBytes, tilePixels.begin() + y * rowBytes);
+            }
+            if (!changed) continue;
+            texture.update(tilePixels.data(), {(unsigned)tileset.tileWidth, (unsigned)tileset.tileHeight}, {left, top});
+            ++changedTiles;
+        }
+        LOG_INFO("Reloaded " << imagePath << ": " << changedTiles << " tiles changed");
+
+        TilesetInfo updated = tileset;
+        classifyOpaqueTiles(image, updated);
+        if (updated.opaqueTiles != tileset.opaqueTiles) return reloadMap();
+        return true;
+    }
+    return false;
+}
+
+std::size_t TileMap::queryContacts(const sf::FloatRect& bounds, TileContact* contacts, std::size_t maxContacts) const{
+    if (_map->layers.empty() || maxContacts == 0) return 0;
+    const auto& tileData = _map->layers[_map->collisionLayer].data;
+    int width = _map->width;
+    int height = _map->height;
+    float tileW = (float)_map->tileWidth;
+    float tileH = (float)_map->tileHeight;
+
+    auto solid = [&](int x, int y){
+        return x >= 0 && x < width && y >= 0 && y < height && _map->getProperties(tileData[y * width + x]).solid;
+    };
+
     // Get the tile coordinates the bounds overlap
-    int startX = std::max(0, (int)(bounds.position.x / _tileWidth));
-    int endX = std::min(_width - 1, (int)((bounds.position.x + bounds.size.x) / _tileWidth));
-    int startY = std::max(0, (int)(bounds.position.y / _tileHeight));
-    int endY = std::min(_height - 1, (int)((bounds.position.y + bounds.size.y) / _tileHeight));
-    
-    // Check all tiles in the range
-    for (int y = startY; y <= endY; ++y) {
-        for (int x = startX; x <= endX; ++x) {
-            int index = y * _width + x;
-            if (index >= (int)_tileData.size()) continue;
-            
-            int tileId = _tileData[index];
-            if (tileId == 0) continue; // Empty tile
-            
-            sf::FloatRect tileBounds = getTileCollisionBounds(x, y);
-            
-            // If this tile has collision bounds
-            if (tileBounds.size.x > 0 && tileBounds.size.y > 0) {
-                // AABB collision
-                if (bounds.position.x < tileBounds.position.x + tileBounds.size.x &&
-                    bounds.position.x + bounds.size.x > tileBounds.position.x &&
-                    bounds.position.y < tileBounds.position.y + tileBounds.size.y &&
-                    bounds.position.y + bounds.size.y > tileBounds.position.y) {
-                    
-                    return Tile(tileId, x, y, tileBounds);
-                }
+    int startX = std::max(0, (int)(bounds.position.x / tileW));
+    int endX = std::min(width - 1, (int)((bounds.position.x + bounds.size.x) / tileW));
+    int startY = std::max(0, (int)(bounds.position.y / tileH));
+    int endY = std::min(height - 1, (int)((bounds.position.y + bounds.size.y) / tileH));
+
+    float boxLeft = bounds.position.x;
+    float boxTop = bounds.position.y;
+    float boxRight = boxLeft + bounds.size.x;
+    float boxBottom = boxTop + bounds.size.y;
+
+    std::size_t count = 0;
+    for (int y = startY; y <= endY; ++y){
+        for (int x = startX; x <= endX; ++x){
+            // solid tiles push boxes out, the rest only count when they hurt
+            const TileProperties& properties = _map->getProperties(tileData[y * width + x]);
+            if (!properties.solid && properties.damage == 0) continue;
+
+            float tileLeft = x * tileW;
+            float tileTop = y * tileH;
+            sf::FloatRect tileBounds({tileLeft, tileTop}, {tileW, tileH});
+            if (!boxesOverlap(bounds, tileBounds)) continue;
+
+            // Depth through each face, faces against another solid tile are
+            // inside the ground and can't push anything out
+            const float blocked = std::numeric_limits<float>::max();
+            float depthLeft = solid(x - 1, y) ? blocked : boxRight - tileLeft;
+            float depthRight = solid(x + 1, y) ? blocked : tileLeft + tileW - boxLeft;
+            float depthTop = solid(x, y - 1) ? blocked : boxBottom - tileTop;
+            float depthBottom = solid(x, y + 1) ? blocked : tileTop + tileH - boxTop;
+            if (depthLeft == blocked && depthRight == blocked && depthTop == blocked && depthBottom == blocked){
+                // buried tile, fall back to the plain smallest overlap
+                depthLeft = boxRight - tileLeft;
+                depthRight = tileLeft + tileW - boxLeft;
+                depthTop = boxBottom - tileTop;
+                depthBottom = tileTop + tileH - boxTop;
+            }
+
+            TileContact contact;
+            contact.gridX = x;
+            contact.gridY = y;
+            contact.bounds = tileBounds;
+            contact.properties = properties;
+            contact.penetration = depthTop;
+            contact.normal = {0.f, -1.f};
+            if (depthBottom < contact.penetration){ contact.penetration = depthBottom; contact.normal = {0.f, 1.f}; }
+            if (depthLeft < contact.penetration){ contact.penetration = depthLeft; contact.normal = {-1.f, 0.f}; }
+            if (depthRight < contact.penetration){ contact.penetration = depthRight; contact.normal = {1.f, 0.f}; }
+
+            // Kept deepest first as they come in, equal depths in scan
+            // order. Once the buffer is full the shallowest one drops out,
+            // so it always holds the deepest maxContacts of them
+            if (count == maxContacts && contacts[count - 1].penetration >= contact.penetration) continue;
+            std::size_t j = count < maxContacts ? count++ : count - 1;
+            for (; j > 0 && contacts[j - 1].penetration < contact.penetration; --j){
+                contacts[j] = contacts[j - 1];
             }
+            contacts[j] = contact;
         }
     }
-    
-    return Tile(); // Returns NONE type
-}
\ No newline at end of file
+    return count;
+}
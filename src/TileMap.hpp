@@ -4,73 +4,199 @@
 #include <string>
 #include <map>
 #include <memory>
-#include <set>
 
 #include "Tile.hpp"
+#include "TileChunk.hpp"
+#include "MapReader.hpp"
+#include "ChunkStreamer.hpp"
+#include "ReleaseQueue.hpp"
+#include "TriggerIndex.hpp"
+#include "ParallaxBackground.hpp"
+#include "ShaderTileRenderer.hpp"
 
-struct TileInfo {
-    std::shared_ptr<sf::Texture> texture;
-    sf::Vector2f position;
-    int layer;
+// One collision tile overlapping a queried box
+struct TileContact {
+    int gridX = 0;
+    int gridY = 0;
+    sf::FloatRect bounds;
+    TileProperties properties;
+    sf::Vector2f normal;     // direction that pushes the box out of the tile
+    float penetration = 0.f; // how far the box is in along that normal
+};
+
+// Contact buffer size for queryContacts, more than the tiles an entity
+// sized box can overlap
+const std::size_t MAX_CONTACTS = 16;
+
+// Fill the render cache skips because opaque tiles cover it
+struct OverdrawStats {
+    std::size_t hiddenCells = 0;   // cells left out of the chunk meshes
+    std::size_t drawnCells = 0;    // cells still drawn, every layer
+    std::size_t pixelsSaved = 0;   // per full redraw of the map
+    std::size_t pixelsDrawn = 0;
 };
 
 class TileMap {
 public:
     TileMap() = default;
 
-    // Load map from Tiled JSON file
+    // Draw tile layers as one shader quad each instead of chunk meshes.
+    // Takes effect on the next load, and only where the map and the GPU
+    // allow it, otherwise the meshes stay
+    void setShaderRendering(bool enabled) { _preferShader = enabled; }
+    bool isShaderRendering() const { return _shaderTiles.isReady(); }
+
+    // Load map from Tiled JSON file, finite or infinite (chunked)
     bool loadFromFile(const std::string& filePath);
 
-    // Get collision tiles (solid ground)
-    const std::vector<TileInfo>& getCollisionTiles() const { return _collisionTiles; }
-    
-    // Get background tiles (decorative, no collision)
-    const std::vector<TileInfo>& getBackgroundTiles() const { return _backgroundTiles; }
+    // Stream chunk render data in and out around the view, call once per
+    // frame before drawing. Chunks on screen are built right away if the
+    // streaming thread has not delivered them yet
+    void updateStreaming(const sf::View& view);
+
+    // Move the tile animations on, call once per frame. Every tile with the
+    // same gid runs off one clock, so only the quads of animations that
+    // reached another frame are touched (with the shader renderer, one
+    // uniform holds the frame of each animation)
+    void updateAnimations(float dt);
 
-    // Draw collision tiles
-    void drawCollisionTiles(sf::RenderWindow& window) const;
-    
-    // Draw background tiles
-    void drawBackgroundTiles(sf::RenderWindow& window) const;
+    // Draw the tiles of solid tilesets, every layer
+    void drawCollisionTiles(sf::RenderTarget& target) const;
+
+    // Draw the tiles of every other tileset, every layer
+    void drawBackgroundTiles(sf::RenderTarget& target) const;
+
+    // Draw the map's image layers as a parallax background, behind everything
+    void drawParallaxBackground(sf::RenderTarget& target) const { _background.draw(target); }
 
     // Get map dimensions
-    int getWidth() const { return _width; }
-    int getHeight() const { return _height; }
-    int getTileWidth() const { return _tileWidth; }
-    int getTileHeight() const { return _tileHeight; }
-    
-    // Get collision bounds for a tile at map position
-    sf::FloatRect getTileCollisionBounds(int mapX, int mapY) const;
+    int getWidth() const { return _map->width; }
+    int getHeight() const { return _map->height; }
+    int getTileWidth() const { return _map->tileWidth; }
+    int getTileHeight() const { return _map->tileHeight; }
+
+    // Offset in tiles from Tiled's origin to our (0,0), non zero only for
+    // infinite maps whose chunks start at negative coordinates
+    sf::Vector2i getOrigin() const { return {_originX, _originY}; }
+
+    // Trigger volumes (win gates, checkpoints, hazards) from the object layers
+    TriggerIndex& getTriggers() { return _triggers; }
 
-    Tile getCollidedTile(const sf::FloatRect& bounds) const;
+    // Where the player starts, from a "spawn" object. False if there is none
+    bool getSpawnPoint(sf::Vector2f& spawn) const;
 
-    
+    // Overdraw removed by dropping hidden cells, worked out at load
+    const OverdrawStats& getOverdrawStats() const { return _overdraw; }
+
+    // Number of chunks that currently have render data resident
+    std::size_t getResidentChunkCount() const { return _residentChunks.size(); }
+
+    // Every solid or damaging collision layer tile overlapping bounds in
+    // one pass, written into the caller's buffer deepest first (ties in
+    // grid order) so resolving them is stable frame to frame. Faces shared
+    // with another solid tile are never picked as the normal, which stops
+    // boxes snagging on seams. With more overlaps than maxContacts the
+    // deepest maxContacts are kept. Returns how many contacts were written
+    std::size_t queryContacts(const sf::FloatRect& bounds, TileContact* contacts, std::size_t maxContacts) const;
+
+    // Index of the solid ground layer, for setTile
+    std::size_t getCollisionLayer() const { return _map->collisionLayer; }
+
+    // Changes one cell after load, for breakable blocks and crumbling
+    // platforms. Collision sees it straight away, the chunk's render data
+    // (or the shader's lookup texel) is patched for just that cell on the
+    // next updateStreaming. Call from the thread running gameplay, the
+    // simulation thread while it runs. False if the cell or gid is invalid
+    bool setTile(std::size_t layer, int x, int y, std::uint32_t gid);
+    bool clearTile(std::size_t layer, int x, int y) { return setTile(layer, x, y, 0); }
+
+    // Dev mode hot reload, called with a file that changed on disk. The map
+    // file and tileset files reload the map and keep the render data of the
+    // chunks that didn't change, tileset images only upload the tiles that
+    // did, image layer pictures are reloaded in place. Returns false if the
+    // file isn't used by this map or couldn't be reloaded. Nothing else may
+    // be reading the map meanwhile
+    bool reloadFile(const std::string& path);
+
+    // Hand every texture over to the release queue and empty the map, so the
+    // GPU frees are spread over the next frames instead of happening at once
+    void releaseResources(ReleaseQueue& queue);
 
 private:
-    std::vector<TileInfo> _collisionTiles;  // Ground/solid tiles
-    std::vector<TileInfo> _backgroundTiles; // Decorative tiles
-    int _width = 0;
-    int _height = 0;
-    int _tileWidth = 0;
-    int _tileHeight = 0;
-    
-    // Store tile IDs for collision queries
-    std::vector<int> _tileData;
-
-    // Cache for loaded tilesets
+    // Trigger buckets are this many tiles wide
+    static const int TRIGGER_BUCKET_TILES = 4;
+
+    // Chunks this far outside the view are prefetched on the streaming thread
+    static const int STREAM_MARGIN = 1;
+    // and chunks further out than this lose their render data
+    static const int EVICT_MARGIN = 2;
+
+    std::shared_ptr<MapData> _map = std::make_shared<MapData>();
+    std::string _mapPath;
+    int _originX = 0;
+    int _originY = 0;
+
+    ParallaxBackground _background;
+    ShaderTileRenderer _shaderTiles;
+    bool _preferShader = false;
+    OverdrawStats _overdraw;
+    TriggerIndex _triggers;
+    sf::Vector2f _spawn;
+    bool _hasSpawn = false;
+
+    // Streaming state, one slot per chunk
+    std::unique_ptr<ChunkStreamer> _streamer;
+    std::vector<std::unique_ptr<ChunkMesh>> _chunkMeshes;
+    std::vector<bool> _chunkPending;
+    std::vector<int> _residentChunks;
+    std::vector<sf::Vector2i> _editedCells; // not patched into render data yet, guarded by the map's edit lock
+
+    // Shared clock of the tile animations and the local tile id each one
+    // shows, -1 until the first updateAnimations
+    sf::Time _animationTime;
+    std::vector<int> _tileFrames;
+    std::vector<std::uint8_t> _framesChanged;
+
+    // Chunk range on screen as of the last updateStreaming call
+    int _drawX0 = 0;
+    int _drawY0 = 0;
+    int _drawX1 = -1;
+    int _drawY1 = -1;
+
+    // Cache for loaded tileset images
     std::map<std::string, std::shared_ptr<sf::Texture>> _textureCache;
-    
-    // Track which tilesets are collision vs background
-    std::set<int> _collisionTilesetGids; // firstGid values for collision tilesets
-
-    // Helper to load tileset and extract tiles
-    std::map<int, std::shared_ptr<sf::Texture>> loadTileset(const std::string& tilesetPath, int firstGid);
-    
-    // Extract a single tile from a tileset image
-    std::shared_ptr<sf::Texture> extractTile(
-        const sf::Texture& tilesetTexture,
-        int tileId,
-        int columns,
-        int tileWidth,
-        int tileHeight);
-};
\ No newline at end of file
+
+    // The cell grids and gid tables in the resource memory, the textures
+    // and meshes count themselves
+    MemoryRecord _mapMemory;
+
+    // Helper to load a tileset and its image
+    bool loadTileset(const std::string& tilesetPath, int firstGid, const std::string& mapPath, TilesetInfo& tileset);
+
+    // Turn object layer objects into trigger volumes and the spawn point
+    void loadObjects(const MapFile& mapFile);
+
+    // Count the cells hidden under opaque tiles and the fill they cost
+    void computeOverdrawStats();
+
+    // Turn image layers into parallax background layers
+    void loadImageLayers(const MapFile& mapFile, const std::string& mapDirectory);
+
+    // Count the cell grids and gid tables in the resource memory
+    void countMapMemory();
+
+    // Patch the cells changed by setTile into the render data
+    void applyEdits();
+
+    // Hot reload helpers
+    bool reloadMap();
+    bool reloadTilesetImage(const std::string& imagePath);
+    static bool chunkChanged(const MapData& a, const MapData& b, int chunkX, int chunkY);
+
+    // Make a chunk's render data resident
+    void storeChunk(ChunkMesh&& mesh);
+
+    // Draws one tile layer's tiles of solid or of other tilesets, through
+    // the shader when it is in use
+    void drawLayer(sf::RenderTarget& target, std::size_t layer, bool solid) const;
+};
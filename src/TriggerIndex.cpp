@@ -0,0 +1,116 @@
+#include "TriggerIndex.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+TriggerKind triggerKindFromString(const std::string& name){
+    if (name == "win") return TriggerKind::WIN;
+    if (name == "checkpoint") return TriggerKind::CHECKPOINT;
+    if (name == "hazard") return TriggerKind::HAZARD;
+    return TriggerKind::OTHER;
+}
+
+void TriggerIndex::bucketRange(const sf::FloatRect& box, int& x0, int& y0, int& x1, int& y1) const{
+    x0 = std::max(0, (int)std::floor((box.position.x - _origin.x) / _bucketSize));
+    y0 = std::max(0, (int)std::floor((box.position.y - _origin.y) / _bucketSize));
+    x1 = std::min(_columns - 1, (int)std::floor((box.position.x + box.size.x - _origin.x) / _bucketSize));
+    y1 = std::min(_rows - 1, (int)std::floor((box.position.y + box.size.y - _origin.y) / _bucketSize));
+}
+
+void TriggerIndex::build(std::vector<TriggerVolume> volumes, float bucketSize){
+    _volumes = std::move(volumes);
+    _bucketSize = bucketSize;
+    _lastSeen.assign(_volumes.size(), 0);
+    _query = 0;
+    _inside.clear();
+    _bucketItems.clear();
+
+    if (_volumes.empty()){
+        _columns = _rows = 0;
+        _bucketStart.assign(1, 0);
+        return;
+    }
+
+    // Grid covers the union of all volumes
+    float minX = _volumes[0].bounds.position.x, minY = _volumes[0].bounds.position.y;
+    float maxX = minX, maxY = minY;
+    for (const auto& volume : _volumes){
+        minX = std::min(minX, volume.bounds.position.x);
+        minY = std::min(minY, volume.bounds.position.y);
+        maxX = std::max(maxX, volume.bounds.position.x + volume.bounds.size.x);
+        maxY = std::max(maxY, volume.bounds.position.y + volume.bounds.size.y);
+    }
+    _origin = {minX, minY};
+    _columns = (int)((maxX - minX) / _bucketSize) + 1;
+    _rows = (int)((maxY - minY) / _bucketSize) + 1;
+
+    // Count per bucket, prefix sum, then fill
+    _bucketStart.assign((std::size_t)_columns * _rows + 1, 0);
+    for (const auto& volume : _volumes){
+        int x0, y0, x1, y1;
+        bucketRange(volume.bounds, x0, y0, x1, y1);
+        for (int y = y0; y <= y1; ++y){
+            for (int x = x0; x <= x1; ++x){
+                ++_bucketStart[y * _columns + x + 1];
+            }
+        }
+    }
+    for (std::size_t i = 1; i < _bucketStart.size(); ++i){
+        _bucketStart[i] += _bucketStart[i - 1];
+    }
+
+    _bucketItems.resize(_bucketStart.back());
+    std::vector<int> fill(_bucketStart.begin(), _bucketStart.end() - 1);
+    for (int i = 0; i < (int)_volumes.size(); ++i){
+        int x0, y0, x1, y1;
+        bucketRange(_volumes[i].bounds, x0, y0, x1, y1);
+        for (int y = y0; y <= y1; ++y){
+            for (int x = x0; x <= x1; ++x){
+                _bucketItems[fill[y * _columns + x]++] = i;
+            }
+        }
+    }
+}
+
+void TriggerIndex::update(const sf::FloatRect& box, std::vector<TriggerEvent>& events){
+    _current.clear();
+
+    if (_columns > 0){
+        ++_query;
+        int x0, y0, x1, y1;
+        bucketRange(box, x0, y0, x1, y1);
+        for (int y = y0; y <= y1; ++y){
+            for (int x = x0; x <= x1; ++x){
+                int bucket = y * _columns + x;
+                for (int i = _bucketStart[bucket]; i < _bucketStart[bucket + 1]; ++i){
+                    int index = _bucketItems[i];
+                    if (_lastSeen[index] == _query) continue;
+                    _lastSeen[index] = _query;
+
+                    const sf::FloatRect& bounds = _volumes[index].bounds;
+                    if (box.position.x < bounds.position.x + bounds.size.x &&
+                        box.position.x + box.size.x > bounds.position.x &&
+                        box.position.y < bounds.position.y + bounds.size.y &&
+                        box.position.y + box.size.y > bounds.position.y){
+                        _current.push_back(index);
+                    }
+                }
+            }
+        }
+        std::sort(_current.begin(), _current.end());
+    }
+
+    // Walk both sorted lists, anything only in one of them changed
+    std::size_t a = 0, b = 0;
+    while (a < _inside.size() || b < _current.size()){
+        if (b == _current.size() || (a < _inside.size() && _inside[a] < _current[b])){
+            events.push_back({&_volumes[_inside[a++]], false});
+        } else if (a == _inside.size() || _current[b] < _inside[a]){
+            events.push_back({&_volumes[_current[b++]], true});
+        } else {
+            ++a;
+            ++b;
+        }
+    }
+    _inside.swap(_current);
+}
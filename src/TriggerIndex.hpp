@@ -0,0 +1,69 @@
+#pragma once
+#include <SFML/Graphics.hpp>
+#include <string>
+#include <vector>
+
+// What touching a trigger volume does, from the Tiled object's class
+enum class TriggerKind {
+    WIN,        // finishes the level
+    CHECKPOINT, // moves the respawn point here
+    HAZARD,     // costs lives like spikes
+    OTHER       // anything else, left for the game to interpret by name
+};
+
+// Parses a Tiled object class ("win", "checkpoint", "hazard"), OTHER if unknown
+TriggerKind triggerKindFromString(const std::string& name);
+
+struct TriggerVolume {
+    int id = 0;
+    std::string name;
+    TriggerKind kind = TriggerKind::OTHER;
+    sf::FloatRect bounds;
+    int damage = 1; // hazards only
+};
+
+// A box starting or stopping overlapping a volume
+struct TriggerEvent {
+    const TriggerVolume* volume = nullptr;
+    bool entered = true; // false when the box left the volume
+};
+
+// Trigger volumes bucketed into a uniform grid. One query per tick tests
+// the player box against just the volumes in the buckets it touches, so
+// the cost stays flat no matter how many volumes a level has
+class TriggerIndex {
+public:
+    TriggerIndex() = default;
+
+    // Replaces the volumes and rebuilds the buckets
+    void build(std::vector<TriggerVolume> volumes, float bucketSize);
+
+    // Tests box against nearby volumes and appends an event for every volume
+    // it entered or left since the previous call
+    void update(const sf::FloatRect& box, std::vector<TriggerEvent>& events);
+
+    // Forget what the box was inside, e.g. after a respawn
+    void reset() { _inside.clear(); }
+
+    const std::vector<TriggerVolume>& getVolumes() const { return _volumes; }
+
+private:
+    std::vector<TriggerVolume> _volumes;
+
+    // Bucket grid covering every volume, stored as one flat list of volume
+    // indices with an offset per bucket
+    float _bucketSize = 128.f;
+    sf::Vector2f _origin;
+    int _columns = 0;
+    int _rows = 0;
+    std::vector<int> _bucketStart; // _columns * _rows + 1 offsets
+    std::vector<int> _bucketItems;
+
+    std::vector<unsigned> _lastSeen; // query stamp per volume, dedupes volumes in several buckets
+    unsigned _query = 0;
+
+    std::vector<int> _inside;  // sorted volume indices the box overlapped last time
+    std::vector<int> _current;
+
+    void bucketRange(const sf::FloatRect& box, int& x0, int& y0, int& x1, int& y1) const;
+};
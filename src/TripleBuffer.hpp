@@ -0,0 +1,43 @@
+#pragma once
+#include <atomic>
+
+// Hands the latest value from one writer thread to one reader thread
+// without locks. There are three copies: the one the writer is filling, the
+// one the reader is looking at, and the newest finished one in between.
+// publish() and update() each swap their side's copy with the middle one in
+// a single atomic exchange, so neither side ever waits on the other. The
+// reader always gets the newest value and skips any it was too slow for
+template <typename T>
+class TripleBuffer {
+public:
+    TripleBuffer() = default;
+    TripleBuffer(const TripleBuffer&) = delete;
+    TripleBuffer& operator=(const TripleBuffer&) = delete;
+
+    // Writer side. The copy still holds whatever was published into it a
+    // few rounds ago, so fill in everything before publishing
+    T& write() { return _buffers[_writeIndex]; }
+    void publish(){
+        int old = _middle.exchange(_writeIndex | FRESH, std::memory_order_acq_rel);
+        _writeIndex = old & INDEX_MASK;
+    }
+
+    // Reader side. Takes the newest published value, false if nothing new
+    // came in since the last call and read() is unchanged
+    bool update(){
+        if (!(_middle.load(std::memory_order_relaxed) & FRESH)) return false;
+        int old = _middle.exchange(_readIndex, std::memory_order_acq_rel);
+        _readIndex = old & INDEX_MASK;
+        return true;
+    }
+    const T& read() const { return _buffers[_readIndex]; }
+
+private:
+    static const int INDEX_MASK = 3;
+    static const int FRESH = 4; // set while the middle copy hasn't been read
+
+    T _buffers[3];
+    int _writeIndex = 0;
+    int _readIndex = 1;
+    std::atomic<int> _middle{2};
+};
@@ -7,27 +7,94 @@
 #include "Animation.hpp"
 #include "TileMap.hpp"
 #include "Tile.hpp"
+#include "ReleaseQueue.hpp"
+#include "EntityWorld.hpp"
+#include "ParticlePool.hpp"
+#include "AabbBench.hpp"
+#include "FramePacer.hpp"
+#include "InputBuffer.hpp"
+#include "SimulationThread.hpp"
+#include "TripleBuffer.hpp"
+#include "FileWatcher.hpp"
+#include "AllocationTracker.hpp"
+#include "FrameArena.hpp"
+#include "ResourceMemory.hpp"
+#include "Log.hpp"
 
 #include <SFML/Graphics.hpp>
 
-#include <iostream>
 #include <optional>
 #include <cmath>
 #include <string>
 #include <vector>
 #include <fstream>
 #include <algorithm>
+#include <cstdlib>
+#include <charconv>
 
 // kind of just used once
 // maybe remove at some point
 const float PLAYER_WIDTH = 32.f;
 const float PLAYER_HEIGHT = 32.f;
+const float GRAVITY = 500.f;
+// one folder per direction, all loaded when the player animation is made
+const std::string PLAYER_FRAMES = "assets/images/player";
 
 // Score constants
 const int POINTS_PER_LEVEL = 1000;
 const int DEATH_PENALTY = 100;
 const int TIME_BONUS_PER_SECOND = 10;
 
+// The world is drawn at this resolution, one texel per world pixel, then
+// blown up to the window by a whole number so the pixel art stays crisp.
+// 960x540 keeps about the framing the old 1.7x shrunk camera had
+const unsigned int RENDER_WIDTH = 960;
+const unsigned int RENDER_HEIGHT = 540;
+
+// Time per frame spent freeing old level resources while playing
+const sf::Time RELEASE_BUDGET = sf::microseconds(500);
+
+// How long a jump or dash press waits for the action to become available
+const sf::Time INPUT_BUFFER_TIME = sf::milliseconds(100);
+
+// The simulation runs on its own thread at this fixed rate, dash lengths
+// are counted in its ticks
+const unsigned int SIM_RATE = 60;
+const float SIM_DT = 1.f / SIM_RATE;
+const sf::Time SIM_TICK = sf::microseconds(1000000 / SIM_RATE);
+
+// Particle effects
+const int DASH_TRAIL_PER_FRAME = 4;
+const int DEATH_DEBRIS_COUNT = 48;
+const float PETALS_PER_SECOND = 12.f;
+const std::string PETAL_TEXTURE = "assets/maybe/pixellab-cherry-blossom-1761687274586.png";
+
+// How a level ended, the simulation stops on anything but NONE
+enum class PlayOutcome {
+    NONE,
+    NEXT_LEVEL,
+    WIN,
+    LOSE
+};
+
+// What the playing loop draws from, published by the simulation after
+// every tick and never changed once published
+struct WorldSnapshot {
+    sf::Time time;                  // end of the tick, on the input clock
+    std::vector<float> posX;        // every entity, in world order
+    std::vector<float> posY;
+    std::size_t player = 0;         // index of the player in those
+    std::string animation;
+    bool dashing = false;
+    bool dashLeft = false;
+    int deaths = 0;                 // counts up, debris is thrown on a change
+    sf::Vector2f deathPosition;
+    int level = 0;
+    int lives = 0;
+    int score = 0;
+    PlayOutcome outcome = PlayOutcome::NONE;
+};
+
 // Leaderboard entry structure
 struct LeaderboardEntry {
     std::string name;
@@ -38,21 +105,38 @@ struct LeaderboardEntry {
     }
 };
 
-// Level data structure
-struct LevelData {
-    std::string mapFile;
-    float spawnX, spawnY;
-    float winX1, winY1, winX2, winY2; // win zone boundaries
-};
+// Level list, one map file per line. Spawn points, win gates, checkpoints
+// and hazards all come from each map's object layer
+const std::string LEVEL_LIST = "assets/levels.txt";
+std::vector<std::string> levels;
 
-// Define all levels here
-std::vector<LevelData> levels = {
-    {"assets/map/map1.json", 96.f, 928.f, 1664.f, 704.f, 1696.f, 736.f},
-    {"assets/map/map2.json", 32.f, 928.f, 256.f, 480.f, 288.f, 512.f},
-    {"assets/map/map3.json", 128.f, 896.f, 1152.f, 512.f, 1184.f, 544.f},
-    // top left, bottom right for final gate
-};
+// --tile-shader draws tile layers with the shader renderer when it can
+bool useTileShader = false;
+
+// --mem-report dumps the resource memory after every level load and at exit
+bool memoryReport = false;
 
+// Appends a number to a string without a temporary std::string
+void appendNumber(std::pmr::string& text, long long number){
+    char digits[24];
+    text.append(digits, std::to_chars(digits, digits + sizeof(digits), number).ptr);
+}
+
+// "<rank>. <name> - <score>" with gap around the dash, built in the given
+// (frame) arena
+std::pmr::string leaderboardLine(std::size_t rank, const LeaderboardEntry& entry, const char* gap, std::pmr::memory_resource* arena){
+    std::pmr::string line(arena);
+    line.reserve(32);
+    appendNumber(line, (long long)rank);
+    line += ".";
+    line += gap;
+    line += entry.name;
+    line += gap;
+    line += "-";
+    line += gap;
+    appendNumber(line, entry.score);
+    return line;
+}
 
 // Leaderboard functions
 std::vector<LeaderboardEntry> loadLeaderboard(const std::string& filename){
@@ -91,46 +175,23 @@ void addToLeaderboard(std::vector<LeaderboardEntry>& leaderboard, const std::str
     }
 }
 
-// Helper function to check AABB collision
-bool checkAABBCollision(sf::FloatRect a, sf::FloatRect b){
-    return a.position.x < b.position.x + b.size.x &&
-           a.position.x + a.size.x > b.position.x &&
-           a.position.y < b.position.y + b.size.y &&
-           a.position.y + a.size.y > b.position.y;
-}
+// Reads the level list, falls back to the three stock maps if it is missing
+std::vector<std::string> loadLevelList(const std::string& filename){
+    std::vector<std::string> levelList;
+    std::ifstream file(filename);
 
-// Helper function to resolve collision 
-void resolveCollision(float& playerX, float& playerY, float& playerVelY, bool& hasJump, bool& hasDash, float& xSpeed, sf::FloatRect playerBounds, sf::FloatRect tileBounds){
-    float overlapLeft = (playerBounds.position.x + playerBounds.size.x) - tileBounds.position.x;
-    float overlapRight = (tileBounds.position.x + tileBounds.size.x) - playerBounds.position.x;
-    float overlapTop = (playerBounds.position.y + playerBounds.size.y) - tileBounds.position.y;
-    float overlapBottom = (tileBounds.position.y + tileBounds.size.y) - playerBounds.position.y;
-
-    // Find smallest overlap
-    float minOverlap = overlapLeft;
-    if (overlapRight < minOverlap) minOverlap = overlapRight;
-    if (overlapTop < minOverlap) minOverlap = overlapTop;
-    if (overlapBottom < minOverlap) minOverlap = overlapBottom;
-
-    if(minOverlap == overlapTop && playerVelY > 0){
-        // Collision from above 
-        playerY = tileBounds.position.y - PLAYER_HEIGHT;
-        playerVelY = 0.f;
-        hasJump = true;
-        hasDash = true;
-    }else if (minOverlap == overlapBottom && playerVelY < 0){
-        // Collision from below 
-        playerY = tileBounds.position.y + tileBounds.size.y;
-        playerVelY = 0.f;
-    }else if (minOverlap == overlapLeft && xSpeed > 0){
-        // Collision from left
-        playerX = tileBounds.position.x - PLAYER_WIDTH;
-        xSpeed = 0.f;
-    }else if (minOverlap == overlapRight && xSpeed < 0){
-        // Collision from right
-        playerX = tileBounds.position.x + tileBounds.size.x;
-        xSpeed = 0.f;
+    if (file.is_open()){
+        std::string mapFile;
+        while (std::getline(file, mapFile)){
+            if (!mapFile.empty() && mapFile[0] != '#') levelList.push_back(mapFile);
+        }
+        file.close();
     }
+    if (levelList.empty()){
+        LOG_WARNING("No levels in " << filename << ", using the built in list");
+        levelList = {"assets/map/map1.json", "assets/map/map2.json", "assets/map/map3.json"};
+    }
+    return levelList;
 }
 
 // Helper function for idle animation
@@ -140,31 +201,42 @@ bool isIdle(float xSpeed){
 }
 
 // Function to load a level
-bool loadLevel(int levelNum, TileMap& tilemap, float& xPos, float& yPos, float& xSpeed, float& ySpeed, bool& hasJump, bool& hasDash, float& mapWidth, float& mapHeight, int& lives){
+bool loadLevel(int levelNum, TileMap& tilemap, ReleaseQueue& releaseQueue, EntityWorld& world, EntityHandle& player, bool& hasJump, bool& hasDash, float& mapWidth, float& mapHeight, int& lives, sf::Vector2f& respawnPoint){
     if (levelNum < 1 || levelNum > (int)levels.size()){
-        std::cerr << "Invalid level number: " << levelNum << "\n";
+        LOG_ERROR("Invalid level number: " << levelNum);
         return false;
     }
     
-    LevelData& level = levels[levelNum - 1];
+    const std::string& mapFile = levels[levelNum - 1];
+    ResourceMemory::resetPeak(); // both levels are resident until the swap
     
     // Create a new TileMap instance
     TileMap newTilemap;
-    if (!newTilemap.loadFromFile(level.mapFile)){
-        std::cerr << "Failed to load level " << levelNum << ": " << level.mapFile << "\n";
+    newTilemap.setShaderRendering(useTileShader);
+    if (!newTilemap.loadFromFile(mapFile)){
+        LOG_ERROR("Failed to load level " << levelNum << ": " << mapFile);
         return false;
     }
     
+    if (!newTilemap.getSpawnPoint(respawnPoint)){
+        LOG_WARNING("Level " << levelNum << " has no spawn object, starting at the top left");
+        respawnPoint = {0.f, 0.f};
+    }
 
-
-    // Replace old tilemap with new one
-    tilemap = newTilemap;
+    // Replace old tilemap with new one. Levels are only loaded from menus
+    // and the loading screen, so the old one is freed right away and the
+    // budget check sees this level on its own
+    tilemap.releaseResources(releaseQueue);
+    tilemap = std::move(newTilemap);
+    releaseQueue.drainAll();
+    ResourceMemory::checkBudget(mapFile);
+    if (memoryReport) ResourceMemory::logReport();
     
-    // Reset player to spawn position
-    xPos = level.spawnX;
-    yPos = level.spawnY;
-    xSpeed = 0.f;
-    ySpeed = 0.f;
+    // The old level's entities go with it, the player is always the first
+    // entity of a fresh world
+    world.clear();
+    world.setCellSize(2.f * tilemap.getTileWidth()); // broadphase cells are 2x2 tiles
+    player = world.create(respawnPoint, {PLAYER_WIDTH, PLAYER_HEIGHT}, GRAVITY, ENTITY_COLLIDES);
     hasJump = true;
     hasDash = true;
     lives = 3;
@@ -176,6 +248,65 @@ bool loadLevel(int levelNum, TileMap& tilemap, float& xPos, float& yPos, float&
     return true;
 }
 
+// Short lived sparks left behind while dashing
+ParticleEmitter dashTrailEmitter(){
+    ParticleEmitter emitter;
+    emitter.area = {PLAYER_WIDTH / 2.f, PLAYER_HEIGHT - 4.f};
+    emitter.speedMax = 15.f;
+    emitter.lifetimeMin = 0.2f;
+    emitter.lifetimeMax = 0.35f;
+    emitter.sizeMin = 3.f;
+    emitter.sizeMax = 6.f;
+    emitter.color = sf::Color(170, 220, 255, 180);
+    return emitter;
+}
+
+// Bits thrown upwards where the player died
+ParticleEmitter deathDebrisEmitter(){
+    ParticleEmitter emitter;
+    emitter.area = {PLAYER_WIDTH, PLAYER_HEIGHT};
+    emitter.angleMin = 200.f;
+    emitter.angleMax = 340.f;
+    emitter.speedMin = 120.f;
+    emitter.speedMax = 260.f;
+    emitter.lifetimeMin = 0.6f;
+    emitter.lifetimeMax = 1.2f;
+    emitter.sizeMin = 2.f;
+    emitter.sizeMax = 4.f;
+    emitter.color = sf::Color(220, 60, 60);
+    return emitter;
+}
+
+// Cherry blossom petals drifting down from above the camera
+ParticleEmitter petalEmitter(float cameraWidth){
+    ParticleEmitter emitter;
+    emitter.area = {cameraWidth * 1.2f, 0.f};
+    emitter.angleMin = 60.f;
+    emitter.angleMax = 120.f;
+    emitter.speedMin = 10.f;
+    emitter.speedMax = 30.f;
+    emitter.lifetimeMin = 12.f;
+    emitter.lifetimeMax = 16.f;
+    emitter.sizeMin = 3.f;
+    emitter.sizeMax = 5.f;
+    return emitter;
+}
+
+// Sends the player back to the respawn point and takes lives and points.
+// Returns the centre of where the player died
+sf::Vector2f killPlayer(EntityWorld& world, EntityHandle player, bool& hasJump, int& lives, int& totalScore, sf::Vector2f respawnPoint, int livesLost){
+    std::size_t p = world.indexOf(player);
+    sf::Vector2f deathPosition = {world.posX[p] + PLAYER_WIDTH / 2.f, world.posY[p] + PLAYER_HEIGHT / 2.f};
+    world.posX[p] = respawnPoint.x;
+    world.posY[p] = respawnPoint.y;
+    world.velY[p] = 0.f;
+    world.velX[p] = 0.f;
+    hasJump = true;
+    lives -= livesLost;
+    totalScore = std::max(0, totalScore - DEATH_PENALTY); // Lose points on death
+    return deathPosition;
+}
+
 // Check for valid leaderboard initials
 bool isValidInitials(const std::string& initials) {
     if (initials.length() != 3) return false;
@@ -186,7 +317,46 @@ bool isValidInitials(const std::string& initials) {
     return true;
 }
 
-int main(){
+int main(int argc, char* argv[]){
+    // log lines are written out by their own thread from here on, and the
+    // ones still waiting when main returns are written before it exits
+    LogWriter logWriter;
+
+    // --fps 60/120/144 (0 for unlocked), --vsync to let the driver pace,
+    // --dev to hot reload edited assets, --alloc-test to fail if playing
+    // allocates once warmed up (needs make TRACK_ALLOCS=1), --mem-budget MB
+    // to warn about levels needing more than that (512 by default), --verbose
+    // for the debug log lines, --aabb-bench to check the batch box tests
+    // against their scalar loops, time them and exit
+    unsigned frameRate = 60;
+    bool vsync = false;
+    bool devMode = false;
+    bool allocationTest = false;
+    bool aabbBench = false;
+    for (int i = 1; i < argc; ++i){
+        std::string arg = argv[i];
+        if (arg == "--tile-shader") useTileShader = true;
+        else if (arg == "--vsync") vsync = true;
+        else if (arg == "--dev") devMode = true;
+        else if (arg == "--alloc-test") allocationTest = true;
+        else if (arg == "--mem-report") memoryReport = true;
+        else if (arg == "--verbose") Log::setLevel(LogLevel::DEBUG);
+        else if (arg == "--aabb-bench") aabbBench = true;
+        else if (arg == "--mem-budget" && i + 1 < argc) ResourceMemory::setBudget((std::size_t)std::max(0, std::atoi(argv[++i])) * 1024 * 1024);
+        else if (arg == "--fps" && i + 1 < argc) frameRate = (unsigned)std::max(0, std::atoi(argv[++i]));
+    }
+
+    if (aabbBench){
+        bool matches = checkAabbBatch();
+        benchmarkAabbBatch();
+        return matches ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    if (allocationTest && !AllocationTracker::isEnabled()){
+        LOG_ERROR("--alloc-test needs a build with TRACK_ALLOCS=1");
+        return EXIT_FAILURE;
+    }
+
     // window making
     unsigned int windowSizeX = 1920;
     unsigned int windowSizeY = 1080;
@@ -194,20 +364,36 @@ int main(){
 
     std::string GAME_STATE = "menu";
 
-    // frame rate set as not to have it hardware limited
-    window.setFramerateLimit(60);
+    // frame pacing, either our own sleep/spin wait or the display's vsync
+    FramePacer pacer(frameRate);
+    pacer.setVsync(vsync);
+    window.setVerticalSyncEnabled(vsync);
+
+    // key presses and releases, fed from the event loops that play
+    InputBuffer input;
+
+    // heap allocations per frame and state, when built in
+    FrameAllocations frameAllocations;
+    if (allocationTest) frameAllocations.setTestMode("playing");
+
+    // strings and lists that only last a frame come from here
+    FrameArenas frameArenas;
+
+    // dev mode, maps, tilesets and animation frames edited under assets are
+    // patched into the running game
+    FileWatcher assetWatcher;
+    if (devMode) assetWatcher.watch("assets");
 
     std::string playerInitials = "";
     int finalScore = 0;
 
     // clock instantiation
-    sf::Clock clock;
     sf::Clock levelClock;
 
     // font and text 
     sf::Font font;
     if (!font.openFromFile("assets/fonts/JAPAN_RAMEN.otf")){
-        std::cerr << "Failed to load font\n";
+        LOG_ERROR("Failed to load font");
         return -1;
     }
 
@@ -278,13 +464,10 @@ int main(){
     float pulseTimer = 0.f;
     float pulseSpeed = 3.f;
 
-    // Game variables
-    float xPos = 96.f;
-    float yPos = 928.f;
-    float xSpeed = 0.f;
-    float ySpeed = 0.f;
+    // Game variables, the player's position and speed live in the entity world
+    EntityWorld world;
+    EntityHandle player;
     float xAccel = 400.f;
-    float yAccel = 500.f; // gravity
 
     int dashLength = 15;
     int dash = 0;
@@ -298,45 +481,322 @@ int main(){
     int totalScore = 0;
 
     // map loading
+    levels = loadLevelList(LEVEL_LIST);
+    sf::Vector2f respawnPoint; // spawn object, or the last checkpoint touched
+    std::vector<TriggerEvent> triggerEvents;
+    ReleaseQueue releaseQueue;
     TileMap tilemap;
     float mapWidth = 0.f;
     float mapHeight = 0.f;
 
-    // Load initial level
-    if (!loadLevel(currentLevel, tilemap, xPos, yPos, xSpeed, ySpeed, hasJump, hasDash, mapWidth, mapHeight, lives)){
+    // Low resolution target for the world, upscaled into the window in
+    // one draw with the HUD on top at full resolution
+    sf::RenderTexture worldTarget;
+    if (!worldTarget.resize({RENDER_WIDTH, RENDER_HEIGHT})){
+        LOG_ERROR("Failed to create the world render texture");
         return -1;
     }
-
-    float cameraShrinkAmount = 1.7;
-    float cameraWidth = windowSizeX / cameraShrinkAmount;
-    float cameraHeight = windowSizeY / cameraShrinkAmount;
-
-    // All animations instantiation
-    Animation background("assets/images/background", 0);
-    background.setScale({4,4});
-    background.setPosition({0,0});
-
-    Animation playerAnim("assets/images/player", 10, true);
-    playerAnim.setDirection("right", "assets/images/player");
-    playerAnim.setPosition({xPos,yPos});
+    worldTarget.setSmooth(false);
+    MemoryRecord worldTargetMemory({ResourceKind::TEXTURE, "", "Renderer", "world target", worldTarget.getSize(),
+                                    ResourceMemory::textureBytes(worldTarget.getSize())});
+    float worldScale = (float)std::max(1u, std::min(windowSizeX / RENDER_WIDTH, windowSizeY / RENDER_HEIGHT));
+    sf::Sprite worldSprite(worldTarget.getTexture());
+    worldSprite.setScale({worldScale, worldScale});
+    // centred, with black bars if the window isn't a multiple of the target
+    worldSprite.setPosition({std::floor((windowSizeX - RENDER_WIDTH * worldScale) / 2.f),
+                             std::floor((windowSizeY - RENDER_HEIGHT * worldScale) / 2.f)});
+
+    float cameraWidth = (float)RENDER_WIDTH;
+    float cameraHeight = (float)RENDER_HEIGHT;
+
+    // HUD text
+    sf::Text hudText(font, "", 32);
+    hudText.setFillColor(sf::Color::White);
+    hudText.setOutlineColor(sf::Color::Black);
+    hudText.setOutlineThickness(2.f);
+    hudText.setPosition({24.f, 16.f});
+    // the HUD string is only rebuilt when one of these changes
+    int shownLevel = -1;
+    int shownLives = -1;
+    int shownScore = -1;
+
+    // F3 while playing pages in what the resource memory holds, rebuilt
+    // only when that changes
+    sf::Text memoryText(font, "", 18);
+    memoryText.setFillColor(sf::Color::White);
+    memoryText.setOutlineColor(sf::Color::Black);
+    memoryText.setOutlineThickness(2.f);
+    memoryText.setPosition({24.f, 64.f});
+    bool showMemory = false;
+    std::uint64_t shownMemory = 0;
+
+    // All animations instantiation, the level background comes from each
+    // map's image layers
+    Animation playerAnim(PLAYER_FRAMES, 10, true);
 
     Animation menuBackground("assets/images/menubackground", 0);
-    background.setScale({4,4});
-    background.setPosition({0,0});
+
+    // Particle effects, one pool and one draw each
+    sf::Texture petalTexture;
+    if (!petalTexture.loadFromFile(PETAL_TEXTURE)){
+        LOG_ERROR("Failed to load petal texture: " << PETAL_TEXTURE);
+    }
+    MemoryRecord petalMemory({ResourceKind::TEXTURE, "", "Particles", PETAL_TEXTURE, petalTexture.getSize(),
+                              ResourceMemory::textureBytes(petalTexture.getSize())});
+    ParticlePool trailParticles(1024);
+    trailParticles.setDrag(3.f);
+    ParticlePool debrisParticles(1024);
+    debrisParticles.setAcceleration({0.f, 700.f});
+    // a 4x4 patch of the blossom canopy makes a petal
+    ParticlePool petalParticles(1024, &petalTexture, sf::IntRect({32, 28}, {4, 4}));
+    petalParticles.setAcceleration({8.f, 15.f});
+    petalParticles.setDrag(0.3f);
+    const ParticleEmitter dashTrail = dashTrailEmitter();
+    const ParticleEmitter deathDebris = deathDebrisEmitter();
+    const ParticleEmitter petals = petalEmitter(cameraWidth);
+    float petalTimer = 0.f;
+
+    // Load initial level, once the shared resources above are counted
+    if (!loadLevel(currentLevel, tilemap, releaseQueue, world, player, hasJump, hasDash, mapWidth, mapHeight, lives, respawnPoint)){
+        return -1;
+    }
+    playerAnim.setPosition(respawnPoint);
     
     // virtual camera 
-    sf::View camera(sf::FloatRect(sf::Vector2f(0, 0), sf::Vector2f(windowSizeX / cameraShrinkAmount, windowSizeY / cameraShrinkAmount)));
+    sf::View camera(sf::FloatRect(sf::Vector2f(0, 0), sf::Vector2f(cameraWidth, cameraHeight)));
     sf::View mainMenu(sf::FloatRect(sf::Vector2f(0, 0), sf::Vector2f(windowSizeX, windowSizeY)));
 
+    // Simulation on its own thread at a fixed rate, the playing loop only
+    // sees the snapshots it publishes after every tick. Everything the step
+    // below touches belongs to that thread while it runs, this thread only
+    // changes it between stop() and the next start (level loads, menus)
+    SimulationThread simulation;
+    TripleBuffer<WorldSnapshot> snapshots;
+    WorldSnapshot previousSnapshot;
+    WorldSnapshot currentSnapshot;
+    sf::Time inputStart;                // input clock at the start of tick 0
+    std::string playerAnimation = "right";
+    int deaths = 0;
+    sf::Vector2f deathPosition;
+    int shownDeaths = 0;                // deaths already thrown debris for
+
+    auto publishSnapshot = [&](sf::Time time, PlayOutcome outcome){
+        WorldSnapshot& snapshot = snapshots.write();
+        snapshot.time = time;
+        snapshot.posX.assign(world.posX.begin(), world.posX.begin() + world.size());
+        snapshot.posY.assign(world.posY.begin(), world.posY.begin() + world.size());
+        snapshot.player = world.indexOf(player);
+        snapshot.animation = playerAnimation;
+        snapshot.dashing = dash > 0;
+        snapshot.dashLeft = !dashDirection;
+        snapshot.deaths = deaths;
+        snapshot.deathPosition = deathPosition;
+        snapshot.level = currentLevel;
+        snapshot.lives = lives;
+        snapshot.score = totalScore;
+        snapshot.outcome = outcome;
+        snapshots.publish();
+    };
+
+    auto simulateTick = [&](std::uint64_t tick) -> bool {
+        const float dt = SIM_DT;
+        // this tick sees the input that came in during its interval
+        sf::Time tickEnd = inputStart + sf::microseconds((std::int64_t)(tick + 1) * 1000000 / SIM_RATE);
+        input.advance(tickEnd);
+
+        // The player's components, these stay put until an entity is
+        // destroyed so they are only bound for this tick
+        std::size_t p = world.indexOf(player);
+        float& xPos = world.posX[p];
+        float& yPos = world.posY[p];
+        float& xSpeed = world.velX[p];
+        float& ySpeed = world.velY[p];
+
+        // WASD controls
+        if (input.held(Action::RIGHT)){
+            playerAnimation = "right";
+            xSpeed = moveSpeed;
+        }else if(input.held(Action::LEFT)){
+            playerAnimation = "left";
+            xSpeed = -moveSpeed;
+        }
+        else{
+            if(xSpeed > 0){
+                xSpeed -= xAccel * world.groundFriction[p] * dt;
+                if(xSpeed < 0) xSpeed = 0.f;
+            }else if(xSpeed < 0){
+                xSpeed += xAccel * world.groundFriction[p] * dt;
+                if(xSpeed > 0) xSpeed = 0.f;
+            }
+        }
+
+        // Jump and dash fire on the press, a press shortly before
+        // they are available again still counts
+        if (hasJump && input.consumeBuffered(Action::JUMP, INPUT_BUFFER_TIME)){
+            ySpeed = -400.f;
+            hasJump = false;
+        }
+
+        if (input.held(Action::CROUCH)){
+            xSpeed /=2;
+        }
+
+        if(input.held(Action::LEFT) && input.held(Action::RIGHT)){
+            xSpeed = 0;
+        }
+
+        if(hasDash && input.consumeBuffered(Action::DASH_RIGHT, INPUT_BUFFER_TIME)){
+            dash = dashLength;
+            dashDirection = true;
+            playerAnimation = "attack_right";
+            hasDash = false;
+        }
+
+        if(hasDash && input.consumeBuffered(Action::DASH_LEFT, INPUT_BUFFER_TIME)){
+            dash = dashLength;
+            dashDirection = false;
+            playerAnimation = "attack_left";
+            hasDash = false;
+        }
+
+        if(dash > 0 && dashDirection){
+            xSpeed = moveSpeed*2;
+        }
+        else if(dash > 0 && !dashDirection){
+            xSpeed = -moveSpeed*2;
+        }
+
+        // Idle animation handling
+        if(isIdle(xSpeed)){
+            if(playerAnimation == "left" || playerAnimation == "attack_left"){
+                playerAnimation = "idle_left";
+            }
+            else if(playerAnimation == "right" || playerAnimation == "attack_right"){
+                playerAnimation = "idle_right";
+            }
+        }
+
+        // Physics engine, gravity and movement for every entity
+        world.integrate(dt);
+
+        if(dash > 0){
+            dash--;
+        }
+        if(dash == 0 && xSpeed != 0){
+            if(playerAnimation == "attack_right"){
+                playerAnimation = "right";
+            }
+            else if(playerAnimation == "attack_left"){
+                playerAnimation = "left";
+            }
+        }
+
+        // Death/ respawn
+        if (yPos >= windowSizeY -32.f){
+            deathPosition = killPlayer(world, player, hasJump, lives, totalScore, respawnPoint, 1);
+            ++deaths;
+            tilemap.getTriggers().reset();
+        }
+
+        // Screen boundaries
+        if(xPos <= 0){
+            xPos = 0;
+            xSpeed = 0;
+        }
+        if(xPos >= windowSizeX -32.f){
+            xPos = windowSizeX -32.f;
+            xSpeed = 0.f;
+        }
+
+        // Trigger volumes, one query against the player box per tick
+        bool reachedGate = false;
+        triggerEvents.clear();
+        tilemap.getTriggers().update(sf::FloatRect({xPos, yPos}, {PLAYER_WIDTH, PLAYER_HEIGHT}), triggerEvents);
+        for (const TriggerEvent& event : triggerEvents){
+            if (!event.entered) continue;
+            const TriggerVolume& volume = *event.volume;
+            if (volume.kind == TriggerKind::WIN){
+                reachedGate = true;
+            }
+            else if (volume.kind == TriggerKind::CHECKPOINT){
+                // respawn standing on the bottom of the checkpoint
+                respawnPoint = {volume.bounds.position.x, volume.bounds.position.y + volume.bounds.size.y - PLAYER_HEIGHT};
+            }
+            else if (volume.kind == TriggerKind::HAZARD){
+                deathPosition = killPlayer(world, player, hasJump, lives, totalScore, respawnPoint, volume.damage);
+                ++deaths;
+                tilemap.getTriggers().reset();
+                break;
+            }
+        }
+
+        // Win detection, the level is loaded by the playing loop
+        if(reachedGate){
+
+            // Calculate level bonus
+            float levelTime = levelClock.getElapsedTime().asSeconds();
+            int timeBonus = std::max(0, (int)(TIME_BONUS_PER_SECOND * (60.f - levelTime))); // 1 min max
+            totalScore += POINTS_PER_LEVEL + timeBonus;
+
+            currentLevel++;
+            // win state change to that screen
+            if(currentLevel > (int)levels.size()){
+                currentLevel = 1; // Reset for replay
+                lives = 3;
+                publishSnapshot(tickEnd, PlayOutcome::WIN);
+            } else {
+                publishSnapshot(tickEnd, PlayOutcome::NEXT_LEVEL);
+            }
+            return false;
+        }
+
+        // lose detection
+        if(lives <= 0){
+            lives = 3;
+            publishSnapshot(tickEnd, PlayOutcome::LOSE);
+            return false;
+        }
+
+        // Tile collision for every entity
+        world.collideTiles(tilemap);
+        if (world.damage[p] > 0){
+            deathPosition = killPlayer(world, player, hasJump, lives, totalScore, respawnPoint, world.damage[p]);
+            ++deaths;
+            tilemap.getTriggers().reset();
+        }
+        else if (world.flags[p] & ENTITY_LANDED){
+            hasJump = true;
+            hasDash = true;
+        }
+        world.animate(dt);
+
+        publishSnapshot(tickEnd, PlayOutcome::NONE);
+        return true;
+    };
+
+    // Starts ticking from the current state, which is published first so
+    // the playing loop always has something to draw
+    auto startSimulation = [&](){
+        inputStart = input.now();
+        publishSnapshot(inputStart, PlayOutcome::NONE);
+        snapshots.update();
+        currentSnapshot = snapshots.read();
+        previousSnapshot = currentSnapshot;
+        shownDeaths = deaths;
+        simulation.start(SIM_RATE, simulateTick);
+    };
+
     // main outer loop
     while (window.isOpen()){
         
         // Menu State
         if(GAME_STATE == "menu"){
-            clock.restart();
+            pacer.reset();
             window.setView(mainMenu);
             while (GAME_STATE == "menu" && window.isOpen()){
-                float dt = clock.restart().asSeconds();
+                float dt = pacer.tick();
+                frameAllocations.beginFrame(GAME_STATE);
+                frameArenas.beginFrame();
                 pulseTimer += dt;
                 
                 // Menu event handling
@@ -353,7 +813,7 @@ int main(){
                             currentLevel = 1;
                             lives = 3;
                             totalScore = 0;
-                            loadLevel(currentLevel, tilemap, xPos, yPos, xSpeed, ySpeed, hasJump, hasDash, mapWidth, mapHeight, lives);
+                            loadLevel(currentLevel, tilemap, releaseQueue, world, player, hasJump, hasDash, mapWidth, mapHeight, lives, respawnPoint);
                             levelClock.restart();
                             GAME_STATE = "playing";
                         }
@@ -380,12 +840,17 @@ int main(){
                 window.draw(exitText);
                 
                 window.display();
+                releaseQueue.drainAll();
             }
         }
         // Leaderboard State
         else if(GAME_STATE == "leaderboard"){
             window.setView(mainMenu);
             while (GAME_STATE == "leaderboard" && window.isOpen()){
+                pacer.tick();
+                frameAllocations.beginFrame(GAME_STATE);
+                frameArenas.beginFrame();
+
                 // Event handling
                 while (const std::optional event = window.pollEvent()){
                     if (event->is<sf::Event::Closed>()){
@@ -414,10 +879,8 @@ int main(){
                 // Draw leaderboard entries
                 float yOffset = 300.f;
                 for (size_t i = 0; i < leaderboard.size() && i < 10; ++i){
-                    std::string entryText = std::to_string(i + 1) + ". " + 
-                                          leaderboard[i].name + " - " + 
-                                          std::to_string(leaderboard[i].score);
-                    sf::Text entry(font, entryText, 32);
+                    std::pmr::string entryText = leaderboardLine(i + 1, leaderboard[i], " ", frameArenas.get());
+                    sf::Text entry(font, entryText.c_str(), 32);
                     entry.setFillColor(sf::Color::White);
                     sf::FloatRect entryBounds = entry.getLocalBounds();
                     entry.setOrigin({entryBounds.size.x / 2.f, 0.f});
@@ -465,12 +928,17 @@ int main(){
         else if(GAME_STATE == "enter_initials"){
             window.setView(mainMenu);
             
+            input.clear();
+
             while (GAME_STATE == "enter_initials" && window.isOpen()){
-                float dt = clock.restart().asSeconds();
+                float dt = pacer.tick();
+                frameAllocations.beginFrame(GAME_STATE);
+                frameArenas.beginFrame();
                 pulseTimer += dt;
                 
                 // Event handling
                 while (const std::optional event = window.pollEvent()){
+                    input.handleEvent(*event);
                     if (event->is<sf::Event::Closed>()){
                         window.close();
                     }
@@ -504,6 +972,7 @@ int main(){
                         }
                     }
                 }
+                input.advance();
                 
                 window.clear();
                 window.draw(menuBackground.getSprite());
@@ -519,7 +988,9 @@ int main(){
                 window.draw(initialsTitle);
                 
                 // Score display
-                sf::Text scoreDisplay(font, "Score: " + std::to_string(finalScore), 40);
+                std::pmr::string scoreLine("Score: ", frameArenas.get());
+                appendNumber(scoreLine, finalScore);
+                sf::Text scoreDisplay(font, scoreLine.c_str(), 40);
                 scoreDisplay.setFillColor(sf::Color::White);
                 sf::FloatRect scoreBounds = scoreDisplay.getLocalBounds();
                 scoreDisplay.setOrigin({scoreBounds.size.x / 2.f, scoreBounds.size.y / 2.f});
@@ -535,12 +1006,12 @@ int main(){
                 window.draw(enterText);
                 
                 // Display typed initials with underscores for remaining letters
-                std::string displayInitials = playerInitials;
+                std::pmr::string displayInitials(playerInitials.begin(), playerInitials.end(), frameArenas.get());
                 while (displayInitials.length() < 3) {
                     displayInitials += "_";
                 }
                 
-                sf::Text initialsDisplay(font, displayInitials, 100);
+                sf::Text initialsDisplay(font, displayInitials.c_str(), 100);
                 initialsDisplay.setFillColor(sf::Color(255, 215, 0));
                 sf::FloatRect initBounds = initialsDisplay.getLocalBounds();
                 initialsDisplay.setOrigin({initBounds.size.x / 2.f, initBounds.size.y / 2.f});
@@ -560,7 +1031,7 @@ int main(){
                 window.draw(instructions);
                 
                 // Error message
-                if (!isValidInitials(playerInitials) && sf::Keyboard::isKeyPressed(sf::Keyboard::Scancode::Enter)) {
+                if (!isValidInitials(playerInitials) && input.held(Action::CONFIRM)) {
                     sf::Text errorText(font, "Must be exactly 3 letters!", 24);
                     errorText.setFillColor(sf::Color::Red);
                     sf::FloatRect errorBounds = errorText.getLocalBounds();
@@ -577,6 +1048,10 @@ int main(){
         else if(GAME_STATE == "leaderboard_display"){
             window.setView(mainMenu);
             while (GAME_STATE == "leaderboard_display" && window.isOpen()){
+                pacer.tick();
+                frameAllocations.beginFrame(GAME_STATE);
+                frameArenas.beginFrame();
+
                 // Event handling
                 while (const std::optional event = window.pollEvent()){
                     if (event->is<sf::Event::Closed>()){
@@ -605,9 +1080,8 @@ int main(){
                 // Draw leaderboard entries
                 float yOffset = 300.f;
                 for (size_t i = 0; i < leaderboard.size() && i < 10; ++i){
-                    std::string entryText = std::to_string(i + 1) + ".  " + 
-                                        leaderboard[i].name + "  -  " + std::to_string(leaderboard[i].score);
-                    sf::Text entry(font, entryText, 32);
+                    std::pmr::string entryText = leaderboardLine(i + 1, leaderboard[i], "  ", frameArenas.get());
+                    sf::Text entry(font, entryText.c_str(), 32);
                     
                     // Highlight the entry that was just added
                     if (leaderboard[i].name == playerInitials && leaderboard[i].score == finalScore) {
@@ -639,6 +1113,10 @@ int main(){
         else if(GAME_STATE == "lose"){
             window.setView(mainMenu);
             while (GAME_STATE == "lose" && window.isOpen()){
+                pacer.tick();
+                frameAllocations.beginFrame(GAME_STATE);
+                frameArenas.beginFrame();
+
                 // Menu event handling
                 while (const std::optional event = window.pollEvent()){
                     if (event->is<sf::Event::Closed>()){
@@ -653,7 +1131,7 @@ int main(){
                             currentLevel = 1;
                             lives = 3;
                             totalScore = 0;
-                            loadLevel(currentLevel, tilemap, xPos, yPos, xSpeed, ySpeed, hasJump, hasDash, mapWidth, mapHeight, lives);
+                            loadLevel(currentLevel, tilemap, releaseQueue, world, player, hasJump, hasDash, mapWidth, mapHeight, lives, respawnPoint);
                             levelClock.restart();
                             GAME_STATE = "playing";
                         }
@@ -679,14 +1157,24 @@ int main(){
 
         // playing state
         else if(GAME_STATE == "playing"){
-            clock.restart(); // Reset clock for clean transition
-            window.setView(camera); // Set the game camera
+            pacer.reset(); // the level load stalled the loop
+            input.clear(); // keys went to the menu until now
+            window.setView(mainMenu); // the camera is on the world target
+            startSimulation();
             
             while (GAME_STATE == "playing" && window.isOpen()){
-                float dt = clock.restart().asSeconds();
+                float dt = pacer.tick();
+                if (!frameAllocations.beginFrame(GAME_STATE)) window.close();
+                frameArenas.beginFrame();
+                if (allocationTest && simulation.getAllocatingTicks() > 0 && !frameAllocations.hasFailed()){
+                    frameAllocations.fail("simulation ticks allocated after warm-up");
+                    window.close();
+                }
 
-                // Game event handling
+                // Game event handling, keys go through the input buffer to
+                // the simulation thread
                 while (const std::optional event = window.pollEvent()){
+                    input.handleEvent(*event);
                     if (event->is<sf::Event::Closed>()){
                         window.close();
                     }
@@ -694,185 +1182,88 @@ int main(){
                         if (keyPressed->scancode == sf::Keyboard::Scancode::Escape){
                             GAME_STATE = "menu";
                         }
+                        else if (keyPressed->scancode == sf::Keyboard::Scancode::F3){
+                            showMemory = !showMemory;
+                        }
                     }
                 }
 
-                // WASD controls
-                if (sf::Keyboard::isKeyPressed(sf::Keyboard::Scancode::D )){
-                    playerAnim.setDirection("right", "assets/images/player");
-                    xSpeed = moveSpeed;
-                }else if(sf::Keyboard::isKeyPressed(sf::Keyboard::Scancode::A)){
-                    playerAnim.setDirection("left", "assets/images/player");
-                    xSpeed = -moveSpeed;
-                }
-                else{
-                    if(xSpeed > 0){
-                        xSpeed -= xAccel * dt;
-                        if(xSpeed < 0) xSpeed = 0.f;
-                    }else if(xSpeed < 0){
-                        xSpeed += xAccel * dt;
-                        if(xSpeed > 0) xSpeed = 0.f;
-                    }
-                }
-
-                if ((sf::Keyboard::isKeyPressed(sf::Keyboard::Scancode::W )|| sf::Keyboard::isKeyPressed(sf::Keyboard::Scancode::K))){
-                    if(hasJump){
-                        ySpeed = -400.f;
-                        hasJump = false;
-                    }
-                }
-
-                if (sf::Keyboard::isKeyPressed(sf::Keyboard::Scancode::S)){
-                    xSpeed /=2;
-                }
-
-                if(sf::Keyboard::isKeyPressed(sf::Keyboard::Scancode::A) && sf::Keyboard::isKeyPressed(sf::Keyboard::Scancode::D)){
-                    xSpeed = 0;
-                }
-
-                if((sf::Keyboard::isKeyPressed(sf::Keyboard::Scancode::E )|| sf::Keyboard::isKeyPressed(sf::Keyboard::Scancode::L )) && hasDash){
-                    dash = dashLength;
-                    dashDirection = true;
-                    playerAnim.setDirection("attack_right", "assets/images/player");
-                    hasDash = false;
-                }
-
-                if((sf::Keyboard::isKeyPressed(sf::Keyboard::Scancode::Q) || sf::Keyboard::isKeyPressed(sf::Keyboard::Scancode::J)) && hasDash){
-                    dash = dashLength;
-                    dashDirection = false;
-                    playerAnim.setDirection("attack_left", "assets/images/player");
-                    hasDash = false;
-                }
-
-                if(dash > 0 && dashDirection){
-                    xSpeed = moveSpeed*2;
-                }
-                else if(dash > 0 && !dashDirection){
-                    xSpeed = -moveSpeed*2;
-                }
-
-                // Idle animation handling
-                if(isIdle(xSpeed)){
-                    if(playerAnim.getCurrentDirection() == "left" || playerAnim.getCurrentDirection() == "attack_left"){
-                        playerAnim.setDirection("idle_left", "assets/images/player");
+                // Edited assets, the simulation pauses while the map is
+                // patched and carries on from where the player was
+                std::vector<std::string> changedFiles = assetWatcher.poll();
+                if (!changedFiles.empty()){
+                    ExpectedAllocations reloading;
+                    simulation.stop();
+                    for (const auto& path : changedFiles){
+                        if (!tilemap.reloadFile(path)) playerAnim.reloadFile(path);
                     }
-                    else if(playerAnim.getCurrentDirection() == "right" || playerAnim.getCurrentDirection() == "attack_right"){
-                        playerAnim.setDirection("idle_right", "assets/images/player");
-                    }
-                }
-
-                // Physics engine
-                ySpeed += yAccel * dt;
-                xPos += xSpeed * dt;
-                yPos += ySpeed * dt;
-
-                if(dash > 0){
-                    dash--;
-                }
-                if(dash == 0 && xSpeed != 0){
-                    if(playerAnim.getCurrentDirection() == "attack_right"){
-                        playerAnim.setDirection("right", "assets/images/player");
+                    // a reloaded map can have grown or shrunk, the camera clamps to it
+                    mapWidth = tilemap.getWidth() * tilemap.getTileWidth();
+                    mapHeight = tilemap.getHeight() * tilemap.getTileHeight();
+                    // a level end published just before stopping wins
+                    if (snapshots.update()){
+                        previousSnapshot = currentSnapshot;
+                        currentSnapshot = snapshots.read();
                     }
-                    else if(playerAnim.getCurrentDirection() == "attack_left"){
-                        playerAnim.setDirection("left", "assets/images/player");
+                    if (currentSnapshot.outcome == PlayOutcome::NONE){
+                        pacer.reset();
+                        startSimulation();
                     }
                 }
 
-                // Death/ respawn
-                if (yPos >= windowSizeY -32.f){
-                    xPos = levels[currentLevel - 1].spawnX;
-                    yPos = levels[currentLevel - 1].spawnY;
-                    ySpeed = 0.f;
-                    xSpeed = 0.f;
-                    hasJump = true;
-                    lives--;
-                    totalScore = std::max(0, totalScore - DEATH_PENALTY); // Lose points on death
+                // Newest state from the simulation
+                if (snapshots.update()){
+                    previousSnapshot = currentSnapshot;
+                    currentSnapshot = snapshots.read();
                 }
 
-                // Screen boundaries
-                if(xPos <= 0){
-                    xPos = 0;
-                    xSpeed = 0;
-                }
-                if(xPos >= windowSizeX -32.f){
-                    xPos = windowSizeX -32.f;
-                    xSpeed = 0.f;
-                }
-
-                // Win detection
-                if(xPos > levels[currentLevel - 1].winX1 && xPos < levels[currentLevel - 1].winX2 && 
-                   yPos > levels[currentLevel - 1].winY1 && yPos < levels[currentLevel - 1].winY2){
-
-                    // Calculate level bonus
-                    float levelTime = levelClock.getElapsedTime().asSeconds();
-                    int timeBonus = std::max(0, (int)(TIME_BONUS_PER_SECOND * (60.f - levelTime))); // 1 min max
-                    totalScore += POINTS_PER_LEVEL + timeBonus;
-
-                    currentLevel++;
-                    // win state change to that screen
-                    if(currentLevel > (int)levels.size()){
+                // The simulation stops itself once the level is over
+                if (currentSnapshot.outcome != PlayOutcome::NONE){
+                    simulation.stop();
+                    if (currentSnapshot.outcome == PlayOutcome::WIN){
                         GAME_STATE = "win";
-                        currentLevel = 1; // Reset for replay
-                        lives = 3;
-                    } else {
-                        // Load next level
-                        loadLevel(currentLevel, tilemap, xPos, yPos, xSpeed, ySpeed, hasJump, hasDash, mapWidth, mapHeight, lives);
-                        std::cout << "Loaded Level " << currentLevel << " - Spawn: (" << xPos << ", " << yPos << ")" << std::endl;
-                        levelClock.restart(); // Reset timer for new level
-                        // Reset dash state
-                        dash = 0;
-                        dashDirection = true;
-                        // Reset animation
-                        playerAnim.setDirection("right", "assets/images/player");
-
-                        window.clear(sf::Color(54, 69, 79));
-                        window.display();
-                        clock.restart();
-                        continue; // Skip rest of this frame, idk why but it works
-
+                        continue;
+                    }
+                    if (currentSnapshot.outcome == PlayOutcome::LOSE){
+                        GAME_STATE = "lose";
+                        continue;
                     }
-                }
-
-                // lose detection
-                if(lives <= 0){
-                    GAME_STATE = "lose";
-                    lives = 3;
-                }
 
-                //spike collision detection
-                sf::FloatRect playerBounds2(sf::Vector2f(xPos, yPos), sf::Vector2f(PLAYER_WIDTH, PLAYER_HEIGHT));
-                Tile collidedTile = tilemap.getCollidedTile(playerBounds2);
-
-                if (collidedTile.isType(TileType::SPIKE)) {
-                    xPos = levels[currentLevel - 1].spawnX;
-                    yPos = levels[currentLevel - 1].spawnY;
-                    ySpeed = 0.f;
-                    xSpeed = 0.f;
-                    hasJump = true;
-                    lives--;
-                    totalScore = std::max(0, totalScore - DEATH_PENALTY);
+                    // Load next level
+                    ExpectedAllocations loading;
+                    loadLevel(currentLevel, tilemap, releaseQueue, world, player, hasJump, hasDash, mapWidth, mapHeight, lives, respawnPoint);
+                    LOG_INFO("Loaded Level " << currentLevel << " - Spawn: (" << respawnPoint.x << ", " << respawnPoint.y << ")");
+                    levelClock.restart(); // Reset timer for new level
+                    // Reset dash state
+                    dash = 0;
+                    dashDirection = true;
+                    // Reset animation
+                    playerAnimation = "right";
+                    playerAnim.setDirection("right");
+                    trailParticles.clear();
+                    debrisParticles.clear();
+                    petalParticles.clear();
+
+                    window.clear(sf::Color(54, 69, 79));
+                    window.display();
+                    pacer.reset();
+                    startSimulation();
+                    continue;
                 }
 
-                // Tile collision detection
-                int playerTileX = (int)(xPos / tilemap.getTileWidth());
-                int playerTileY = (int)(yPos / tilemap.getTileHeight());
-
-                sf::FloatRect playerBounds(sf::Vector2f(xPos, yPos), sf::Vector2f(PLAYER_WIDTH, PLAYER_HEIGHT));
-
-                // Check surrounding tiles (3x3 grid)
-                for (int dy = -1; dy <= 1; ++dy){
-                    for (int dx = -1; dx <= 1; ++dx){
-                        sf::FloatRect tileBounds = tilemap.getTileCollisionBounds(playerTileX + dx, playerTileY + dy);
-                        
-                        if (tileBounds.size.x > 0 && tileBounds.size.y > 0){
-                            if (checkAABBCollision(playerBounds, tileBounds)){
-                                resolveCollision(xPos, yPos, ySpeed, hasJump, hasDash, xSpeed, playerBounds, tileBounds);
-                                playerBounds.position.x = xPos;
-                                playerBounds.position.y = yPos;
-                            }
-                        }
-                    }
+                // Draw one tick behind the simulation, between the last two
+                // snapshots, so motion stays smooth whatever the frame rate.
+                // Respawns jump straight to the new position
+                const WorldSnapshot& from = previousSnapshot;
+                const WorldSnapshot& to = currentSnapshot;
+                float alpha = 1.f;
+                if (to.time > from.time && to.deaths == from.deaths && from.player < from.posX.size()){
+                    sf::Time renderTime = input.now() - SIM_TICK;
+                    alpha = std::clamp((renderTime - from.time).asSeconds() / (to.time - from.time).asSeconds(), 0.f, 1.f);
                 }
+                const WorldSnapshot& start = alpha < 1.f ? from : to;
+                float xPos = start.posX[start.player] + (to.posX[to.player] - start.posX[start.player]) * alpha;
+                float yPos = start.posY[start.player] + (to.posY[to.player] - start.posY[start.player]) * alpha;
 
                 // Camera update
                 float clampedCameraX = xPos + PLAYER_WIDTH / 2.f;
@@ -892,31 +1283,95 @@ int main(){
                     clampedCameraY = mapHeight - cameraHeight / 2.f;
                 }
 
-                camera.setCenter(sf::Vector2f(clampedCameraX, clampedCameraY));
-                window.setView(camera);
+                // whole pixels only, anything else shimmers once upscaled
+                camera.setCenter(sf::Vector2f(std::round(clampedCameraX), std::round(clampedCameraY)));
+                worldTarget.setView(camera);
+                {
+                    ExpectedAllocations streaming; // chunks coming into view are built
+                    tilemap.updateStreaming(camera);
+                }
+                tilemap.updateAnimations(dt);
+
+                // Particle effects
+                if(to.dashing){
+                    trailParticles.emit(dashTrail, {xPos + PLAYER_WIDTH / 2.f, yPos + PLAYER_HEIGHT / 2.f}, DASH_TRAIL_PER_FRAME);
+                }
+                if(to.deaths != shownDeaths){
+                    debrisParticles.emit(deathDebris, to.deathPosition, DEATH_DEBRIS_COUNT);
+                    shownDeaths = to.deaths;
+                }
+                petalTimer += dt * PETALS_PER_SECOND;
+                int petalCount = (int)petalTimer;
+                petalTimer -= petalCount;
+                petalParticles.emit(petals, {clampedCameraX, clampedCameraY - cameraHeight / 2.f - 8.f}, petalCount);
+
+                // only what the camera sees is drawn
+                sf::FloatRect viewBounds(camera.getCenter() - camera.getSize() / 2.f, camera.getSize());
+                trailParticles.update(dt, viewBounds);
+                debrisParticles.update(dt, viewBounds);
+                petalParticles.update(dt, viewBounds);
                 
                 
-                // Rendering
+                // Rendering, the world at native resolution first
                 sf::Color color(1, 2, 3);
-                window.clear(color);
+                worldTarget.clear(color);
 
-                window.draw(background.getSprite());
-                tilemap.drawBackgroundTiles(window);
-                tilemap.drawCollisionTiles(window);
+                tilemap.drawParallaxBackground(worldTarget);
+                tilemap.drawBackgroundTiles(worldTarget);
+                tilemap.drawCollisionTiles(worldTarget);
+                trailParticles.draw(worldTarget);
 
-                if(dash > 0 && !dashDirection){
+                // the animation frames are textures, so they stay on this thread
+                playerAnim.setDirection(to.animation);
+                playerAnim.update(dt);
+                if(to.dashing && to.dashLeft){
                     playerAnim.setPosition({xPos-28, yPos});
                 }
                 else{
                     playerAnim.setPosition({xPos, yPos});
                 }
-                playerAnim.update(dt);
-                window.draw(playerAnim.getSprite());
-
-                
+                worldTarget.draw(playerAnim.getSprite());
+                debrisParticles.draw(worldTarget);
+                petalParticles.draw(worldTarget);
+                worldTarget.display();
+
+                // then scaled up into the window, and the HUD at full resolution
+                window.clear(sf::Color::Black);
+                window.draw(worldSprite);
+                if (to.level != shownLevel || to.lives != shownLives || to.score != shownScore){
+                    ExpectedAllocations hud; // only on a death, a new level or points
+                    shownLevel = to.level;
+                    shownLives = to.lives;
+                    shownScore = to.score;
+                    hudText.setString("Level " + std::to_string(to.level) + "   Lives " + std::to_string(to.lives) + "   Score " + std::to_string(to.score));
+                }
+                window.draw(hudText);
+                if (showMemory){
+                    if (ResourceMemory::getRevision() != shownMemory){
+                        ExpectedAllocations overlay; // a debug page, not gameplay
+                        shownMemory = ResourceMemory::getRevision();
+                        memoryText.setString(ResourceMemory::summary());
+                    }
+                    window.draw(memoryText);
+                }
                 window.display();
+
+                // free whatever the last level left behind, within budget
+                releaseQueue.drain(RELEASE_BUDGET);
+            }
+            simulation.stop();
+            pacer.logStats("playing");
+            if (simulation.getDroppedTicks() > 0){
+                LOG_INFO("Simulation dropped " << simulation.getDroppedTicks() << " ticks");
+            }
+            if (simulation.getAllocatingTicks() > 0){
+                LOG_INFO("Simulation ticks that allocated after warm-up: " << simulation.getAllocatingTicks());
             }
         }
     }
-    return 0;
+
+    if (AllocationTracker::isEnabled()) frameAllocations.logStats();
+    frameArenas.logStats("Main");
+    if (memoryReport) ResourceMemory::logReport();
+    return frameAllocations.hasFailed() ? EXIT_FAILURE : 0;
 }